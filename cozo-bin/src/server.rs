@@ -46,7 +46,8 @@ pub(crate) struct ServerArgs {
     #[clap(short, long, default_value_t = String::from("cozo.db"))]
     path: String,
 
-    /// Restore from the specified backup before starting the server
+    /// Restore from the specified backup before starting the server. With the `rocksdb` engine,
+    /// this can also be a directory of incremental backups, whose latest backup is restored.
     #[clap(long)]
     restore: Option<String>,
 
@@ -191,8 +192,26 @@ where
 fn x() {}
 
 pub(crate) async fn server_main(args: ServerArgs) {
+    // Incremental backups are restored by copying their files before the database is opened
+    #[cfg(feature = "storage-rocksdb")]
+    let restored = match &args.restore {
+        Some(p) if args.engine == "rocksdb" && std::path::Path::new(p).join("meta").is_dir() => {
+            if let Err(err) =
+                cozo::restore_cozo_rocksdb_backup(p, None, &args.path, &Default::default())
+            {
+                error!("{}", err);
+                error!("Restore from backup failed, terminate");
+                panic!()
+            }
+            true
+        }
+        _ => false,
+    };
+    #[cfg(not(feature = "storage-rocksdb"))]
+    let restored = false;
+
     let db = DbInstance::new(&args.engine, &args.path, &args.config).unwrap();
-    if let Some(p) = &args.restore {
+    if let Some(p) = args.restore.as_ref().filter(|_| !restored) {
         if let Err(err) = db.restore_backup(p) {
             error!("{}", err);
             error!("Restore from backup failed, terminate");
@@ -249,6 +268,7 @@ pub(crate) async fn server_main(args: ServerArgs) {
         .route("/backup", post(backup))
         .route("/import-from-backup", post(import_from_backup))
         .route("/changes/:relation", get(observe_changes))
+        .route("/changes-since/:seq", get(changes_since))
         // .route("/rules/:name", get(register_rule))
         // .route(
         //     "/rule-result/:id",
@@ -469,13 +489,39 @@ async fn import_relations(
 #[derive(serde_derive::Deserialize)]
 struct BackupPayload {
     path: String,
+    /// Take an incremental backup into the directory at `path`, for the `rocksdb` engine only
+    #[serde(default)]
+    incremental: bool,
+    /// Write a checkpoint directory at `path` instead of an SQLite file, for the `rocksdb` engine only
+    #[serde(default)]
+    checkpoint: bool,
+}
+
+fn incremental_backup(db: &DbInstance, path: &str) -> miette::Result<()> {
+    match db {
+        #[cfg(feature = "storage-rocksdb")]
+        DbInstance::RocksDb(db) => db
+            .storage()
+            .incremental_backup(path, &Default::default())
+            .map(|_| ()),
+        _ => miette::bail!("incremental backups require the rocksdb engine"),
+    }
 }
 
 async fn backup(
     State(st): State<DbState>,
     Json(payload): Json<BackupPayload>,
 ) -> (StatusCode, Json<serde_json::Value>) {
-    let result = spawn_blocking(move || st.db.backup_db(payload.path)).await;
+    let result = spawn_blocking(move || {
+        if payload.incremental {
+            incremental_backup(&st.db, &payload.path)
+        } else if payload.checkpoint {
+            st.db.checkpoint_db(payload.path)
+        } else {
+            st.db.backup_db(payload.path)
+        }
+    })
+    .await;
 
     match result {
         Ok(Ok(())) => {
@@ -662,6 +708,40 @@ async fn observe_changes(
     Sse::new(stream).keep_alive(KeepAlive::default())
 }
 
+/// Changes read back from the log of the storage engine, which unlike `/changes/:relation`
+/// include those made before a restart or by other processes. Resume from the last `seq` plus one.
+async fn changes_since(
+    State(st): State<DbState>,
+    Path(seq): Path<u64>,
+) -> (StatusCode, Json<serde_json::Value>) {
+    const CHANGES_PER_REQUEST: usize = 1024;
+    let result = spawn_blocking(move || st.db.changes_since(seq, CHANGES_PER_REQUEST)).await;
+    match result {
+        Ok(Ok(changes)) => {
+            let changes = changes
+                .into_iter()
+                .map(|change| {
+                    json!({
+                        "seq": change.seq,
+                        "relation": change.relation,
+                        "op": format!("{:?}", change.op),
+                        "tuple": change.tuple.into_iter().map(serde_json::Value::from).collect_vec(),
+                    })
+                })
+                .collect_vec();
+            (
+                StatusCode::OK,
+                json!({"ok": true, "changes": changes}).into(),
+            )
+        }
+        Ok(Err(err)) => {
+            let ret = json!({"ok": false, "message": err.to_string()});
+            (StatusCode::BAD_REQUEST, ret.into())
+        }
+        Err(err) => internal_error(err),
+    }
+}
+
 async fn root() -> Html<&'static str> {
     Html(include_str!("./index.html"))
 }
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022, The Cozo Project Authors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#![cfg(feature = "storage-rocksdb")]
+#![feature(test)]
+
+extern crate test;
+
+use std::env;
+use std::time::Instant;
+use test::Bencher;
+
+use lazy_static::lazy_static;
+
+use cozo::{new_cozo_rocksdb_with_options, Db, RocksDbOptions, RocksDbStorage, Storage, StoreTx};
+
+lazy_static! {
+    static ref ROWS: usize = {
+        let n = env::var("COZO_BENCH_SCAN_ROWS").unwrap_or("2000".to_string());
+        n.parse::<usize>().unwrap()
+    };
+}
+
+/// Keys are put under a relation id that no relation uses, so that they never clash with data.
+const BENCH_RELATION_ID: u64 = u64::MAX - 1;
+
+/// Opens a database holding `ROWS` rows whose values are `value_size` bytes long.
+fn populate(name: &str, value_size: usize) -> Db<RocksDbStorage> {
+    let path = env::temp_dir().join(format!("_cozo_scan_bench_{name}"));
+    let _ = std::fs::remove_dir_all(&path);
+    let db = new_cozo_rocksdb_with_options(&path, &RocksDbOptions::default()).unwrap();
+    let mut tx = db.storage().transact(true).unwrap();
+    let value = vec![0xAB; value_size];
+    for i in 0..*ROWS {
+        let mut key = BENCH_RELATION_ID.to_be_bytes().to_vec();
+        key.extend_from_slice(&(i as u64).to_be_bytes());
+        tx.put(&key, &value).unwrap();
+    }
+    tx.commit().unwrap();
+    db
+}
+
+/// Scans all rows once per iteration. Batches fetched from the iterator cross over to Rust
+/// in one copy each, so the throughput here should stay close to that of a memcpy.
+fn bench_scan(b: &mut Bencher, name: &str, value_size: usize) {
+    let db = populate(name, value_size);
+    let lower = BENCH_RELATION_ID.to_be_bytes();
+    let upper = (BENCH_RELATION_ID + 1).to_be_bytes();
+    let mut scans = 0;
+    let start = Instant::now();
+    b.iter(|| {
+        let tx = db.storage().transact(false).unwrap();
+        let mut bytes = 0;
+        for kv in tx.range_scan(&lower, &upper) {
+            let (k, v) = kv.unwrap();
+            bytes += k.len() + v.len();
+        }
+        assert_eq!(bytes, *ROWS * (16 + value_size));
+        scans += 1;
+    });
+    let secs = start.elapsed().as_secs_f64();
+    println!(
+        "{name}: {scans} scans in {secs:.2}s, {:.1} MiB/s",
+        (scans * *ROWS * (16 + value_size)) as f64 / secs / (1 << 20) as f64
+    );
+}
+
+#[bench]
+fn scan_narrow_rows(b: &mut Bencher) {
+    bench_scan(b, "narrow", 100);
+}
+
+#[bench]
+fn scan_wide_rows(b: &mut Bencher) {
+    bench_scan(b, "wide", 64 << 10);
+}
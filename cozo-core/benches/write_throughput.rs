@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022, The Cozo Project Authors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#![cfg(feature = "storage-rocksdb")]
+#![feature(test)]
+
+extern crate test;
+
+use std::env;
+use std::thread;
+use std::time::Instant;
+use test::Bencher;
+
+use lazy_static::lazy_static;
+
+use cozo::{new_cozo_rocksdb_with_options, Db, RocksDbOptions, RocksDbStorage, Storage, StoreTx};
+
+lazy_static! {
+    static ref WRITERS: usize = {
+        let n = env::var("COZO_BENCH_WRITERS").unwrap_or("8".to_string());
+        n.parse::<usize>().unwrap()
+    };
+    static ref ROWS_PER_WRITER: usize = {
+        let n = env::var("COZO_BENCH_ROWS_PER_WRITER").unwrap_or("100000".to_string());
+        n.parse::<usize>().unwrap()
+    };
+}
+
+/// Keys are put under a relation id that no relation uses, so that they never clash with data.
+const BENCH_RELATION_ID: u64 = u64::MAX - 1;
+const VALUE_SIZE: usize = 100;
+
+fn open_db(name: &str, opts: &RocksDbOptions) -> Db<RocksDbStorage> {
+    let path = env::temp_dir().join(format!("_cozo_write_bench_{name}"));
+    let _ = std::fs::remove_dir_all(&path);
+    new_cozo_rocksdb_with_options(&path, opts).unwrap()
+}
+
+/// Puts `WRITERS * ROWS_PER_WRITER` rows in one transaction from `WRITERS` threads in parallel,
+/// then commits.
+fn write_rows(db: &Db<RocksDbStorage>, round: u64) {
+    let mut tx = db.storage().transact(true).unwrap();
+    let value = vec![0xAB; VALUE_SIZE];
+    thread::scope(|s| {
+        for writer in 0..*WRITERS {
+            let tx = &tx;
+            let value = &value;
+            s.spawn(move || {
+                let mut key = Vec::with_capacity(24);
+                for i in 0..*ROWS_PER_WRITER {
+                    key.clear();
+                    key.extend_from_slice(&BENCH_RELATION_ID.to_be_bytes());
+                    key.extend_from_slice(&round.to_be_bytes());
+                    key.extend_from_slice(&((writer * *ROWS_PER_WRITER + i) as u64).to_be_bytes());
+                    tx.par_put(&key, value).unwrap();
+                }
+            });
+        }
+    });
+    tx.commit().unwrap();
+}
+
+fn bench_writes(b: &mut Bencher, name: &str, opts: RocksDbOptions) {
+    let db = open_db(name, &opts);
+    let mut round = 0;
+    let start = Instant::now();
+    b.iter(|| {
+        write_rows(&db, round);
+        round += 1;
+    });
+    let rows = round as usize * *WRITERS * *ROWS_PER_WRITER;
+    let secs = start.elapsed().as_secs_f64();
+    println!(
+        "{name}: {rows} rows in {secs:.2}s, {:.0} rows/s, {:.1} MiB/s",
+        rows as f64 / secs,
+        (rows * (24 + VALUE_SIZE)) as f64 / secs / (1 << 20) as f64
+    );
+}
+
+#[bench]
+fn par_put_default(b: &mut Bencher) {
+    bench_writes(b, "default", RocksDbOptions::default());
+}
+
+#[bench]
+fn par_put_pipelined(b: &mut Bencher) {
+    bench_writes(
+        b,
+        "pipelined",
+        RocksDbOptions {
+            enable_pipelined_write: true,
+            write_buffer_size: Some(128 << 20),
+            max_write_buffer_number: Some(4),
+            write_buffer_memory_budget: Some(512 << 20),
+            ..Default::default()
+        },
+    );
+}
+
+#[bench]
+fn par_put_unordered(b: &mut Bencher) {
+    bench_writes(
+        b,
+        "unordered",
+        RocksDbOptions {
+            write_policy: Some("prepared".to_string()),
+            unordered_write: true,
+            write_buffer_size: Some(128 << 20),
+            max_write_buffer_number: Some(4),
+            write_buffer_memory_budget: Some(512 << 20),
+            ..Default::default()
+        },
+    );
+}
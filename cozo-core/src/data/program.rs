@@ -124,6 +124,9 @@ impl Display for QueryOutOptions {
                 RelationOp::EnsureNot => {
                     write!(f, ":ensure_not ")?;
                 }
+                RelationOp::Accumulate(accum_op) => {
+                    write!(f, ":accumulate {accum_op} ")?;
+                }
             }
             write!(f, "{name} {{")?;
             let mut is_first = true;
@@ -200,6 +203,31 @@ pub(crate) enum RelationOp {
     Delete,
     Ensure,
     EnsureNot,
+    Accumulate(AccumOp),
+}
+
+/// How `:accumulate` combines the given non-key values with the stored ones.
+#[derive(
+    Debug, Copy, Clone, Eq, PartialEq, serde_derive::Serialize, serde_derive::Deserialize,
+)]
+pub(crate) enum AccumOp {
+    Sum,
+    Count,
+    Min,
+    Max,
+    BitOr,
+}
+
+impl Display for AccumOp {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        match self {
+            AccumOp::Sum => write!(f, "sum"),
+            AccumOp::Count => write!(f, "count"),
+            AccumOp::Min => write!(f, "min"),
+            AccumOp::Max => write!(f, "max"),
+            AccumOp::BitOr => write!(f, "bit_or"),
+        }
+    }
 }
 
 #[derive(Default)]
@@ -465,6 +493,8 @@ pub(crate) struct InputProgram {
     pub(crate) prog: BTreeMap<Symbol, InputInlineRulesOrFixed>,
     pub(crate) out_opts: QueryOutOptions,
     pub(crate) disable_magic_rewrite: bool,
+    /// Reorder consecutive stored relations in rule bodies by their estimated sizes
+    pub(crate) reorder_relations: bool,
 }
 
 impl Display for InputProgram {
@@ -681,7 +711,8 @@ impl InputProgram {
                                 aggr: rule.aggr.clone(),
                                 body,
                             };
-                            collected_rules.push(normalized_rule.convert_to_well_ordered_rule()?);
+                            collected_rules.push(normalized_rule
+                                .convert_to_well_ordered_rule(tx, self.reorder_relations)?);
                         }
                     }
                     prog.insert(
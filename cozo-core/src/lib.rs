@@ -51,19 +51,26 @@ use serde_json::json;
 pub use data::value::{DataValue, Num, RegexWrapper, UuidWrapper, Validity, ValidityTs};
 pub use fixed_rule::{FixedRule, FixedRuleInputRelation, FixedRulePayload};
 pub use runtime::db::Db;
+pub use runtime::db::{ChangeEvent, ChangeOp};
 pub use runtime::db::NamedRows;
 pub use runtime::relation::decode_tuple_from_kv;
 pub use runtime::temp_store::RegularTempStore;
 pub use storage::mem::{new_cozo_mem, MemStorage};
 #[cfg(feature = "storage-rocksdb")]
-pub use storage::rocks::{new_cozo_rocksdb, RocksDbStorage};
+pub use storage::rocks::{
+    list_cozo_rocksdb_backups, new_cozo_rocksdb, new_cozo_rocksdb_with_options,
+    restore_cozo_rocksdb_backup, verify_cozo_rocksdb_backup, RocksDbBackupOptions,
+    RocksDbColumnFamilyOptions, RocksDbOptions, RocksDbStorage,
+};
+#[cfg(feature = "storage-rocksdb")]
+pub use cozorocks::BackupEntry as RocksDbBackupEntry;
 #[cfg(feature = "storage-sled")]
 pub use storage::sled::{new_cozo_sled, SledStorage};
 #[cfg(feature = "storage-sqlite")]
 pub use storage::sqlite::{new_cozo_sqlite, SqliteStorage};
 #[cfg(feature = "storage-tikv")]
 pub use storage::tikv::{new_cozo_tikv, TiKvStorage};
-pub use storage::{Storage, StoreTx};
+pub use storage::{LoggedOp, LoggedWrite, RelationStats, Storage, StoreTx};
 
 pub use crate::data::expr::Expr;
 use crate::data::json::JsonValue;
@@ -134,7 +141,7 @@ impl DbInstance {
     /// some of the engines are available. The `mem` engine is always available.
     ///
     /// `path` is ignored for `mem` and `tikv` engines.
-    /// `options` is ignored for every engine except `tikv`.
+    /// `options` is ignored for every engine except `rocksdb` (see [RocksDbOptions]) and `tikv`.
     #[allow(unused_variables)]
     pub fn new(engine: &str, path: impl AsRef<Path>, options: &str) -> Result<Self> {
         let options = if options.is_empty() { "{}" } else { options };
@@ -143,7 +150,14 @@ impl DbInstance {
             #[cfg(feature = "storage-sqlite")]
             "sqlite" => Self::Sqlite(new_cozo_sqlite(path)?),
             #[cfg(feature = "storage-rocksdb")]
-            "rocksdb" => Self::RocksDb(new_cozo_rocksdb(path)?),
+            "rocksdb" => {
+                let opts: RocksDbOptions = if options.trim().is_empty() {
+                    Default::default()
+                } else {
+                    serde_json::from_str(options).into_diagnostic()?
+                };
+                Self::RocksDb(new_cozo_rocksdb_with_options(path, &opts)?)
+            }
             #[cfg(feature = "storage-sled")]
             "sled" => Self::Sled(new_cozo_sled(path)?),
             #[cfg(feature = "storage-tikv")]
@@ -355,6 +369,20 @@ impl DbInstance {
             Err(err) => json!({"ok": false, "message": err.to_string()}).to_string(),
         }
     }
+    /// Dispatcher method. See [crate::Db::checkpoint_db].
+    pub fn checkpoint_db(&self, out_dir: impl AsRef<Path>) -> Result<()> {
+        match self {
+            DbInstance::Mem(db) => db.checkpoint_db(out_dir),
+            #[cfg(feature = "storage-sqlite")]
+            DbInstance::Sqlite(db) => db.checkpoint_db(out_dir),
+            #[cfg(feature = "storage-rocksdb")]
+            DbInstance::RocksDb(db) => db.checkpoint_db(out_dir),
+            #[cfg(feature = "storage-sled")]
+            DbInstance::Sled(db) => db.checkpoint_db(out_dir),
+            #[cfg(feature = "storage-tikv")]
+            DbInstance::TiKv(db) => db.checkpoint_db(out_dir),
+        }
+    }
     /// Dispatcher method. See [crate::Db::restore_backup].
     pub fn restore_backup(&self, in_file: impl AsRef<Path>) -> Result<()> {
         match self {
@@ -369,7 +397,7 @@ impl DbInstance {
             DbInstance::TiKv(db) => db.restore_backup(in_file),
         }
     }
-    /// Restore from an Sqlite backup, with JSON string return value.
+    /// Restore from a backup, with JSON string return value.
     /// See [crate::Db::restore_backup].
     pub fn restore_backup_str(&self, in_file: impl AsRef<Path>) -> String {
         match self.restore_backup(in_file) {
@@ -395,7 +423,7 @@ impl DbInstance {
             DbInstance::TiKv(db) => db.import_from_backup(in_file, relations),
         }
     }
-    /// Import relations from an Sqlite backup, with JSON string return value.
+    /// Import relations from a backup, with JSON string return value.
     /// See [crate::Db::import_from_backup].
     pub fn import_from_backup_str(&self, payload: &str) -> String {
         match self.import_from_backup_str_inner(payload) {
@@ -413,6 +441,20 @@ impl DbInstance {
 
         self.import_from_backup(&json_payload.path, &json_payload.relations)
     }
+    /// Dispatcher method. See [crate::Db::changes_since].
+    pub fn changes_since(&self, seq: u64, limit: usize) -> Result<Vec<ChangeEvent>> {
+        match self {
+            DbInstance::Mem(db) => db.changes_since(seq, limit),
+            #[cfg(feature = "storage-sqlite")]
+            DbInstance::Sqlite(db) => db.changes_since(seq, limit),
+            #[cfg(feature = "storage-rocksdb")]
+            DbInstance::RocksDb(db) => db.changes_since(seq, limit),
+            #[cfg(feature = "storage-sled")]
+            DbInstance::Sled(db) => db.changes_since(seq, limit),
+            #[cfg(feature = "storage-tikv")]
+            DbInstance::TiKv(db) => db.changes_since(seq, limit),
+        }
+    }
 
     /// Dispatcher method. See [crate::Db::register_callback].
     #[cfg(not(target_arch = "wasm32"))]
@@ -547,7 +589,7 @@ impl MultiTransaction {
             bail!(err);
         }
         match self.receiver.recv() {
-            Ok(_) => Ok(()),
+            Ok(r) => r.map(|_| ()),
             Err(err) => bail!(err),
         }
     }
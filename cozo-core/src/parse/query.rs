@@ -22,7 +22,7 @@ use thiserror::Error;
 use crate::data::aggr::{parse_aggr, Aggregation};
 use crate::data::expr::Expr;
 use crate::data::functions::{str2vld, MAX_VALIDITY_TS};
-use crate::data::program::{FixedRuleApply, FixedRuleArg, InputAtom, InputInlineRule, InputInlineRulesOrFixed, InputNamedFieldRelationApplyAtom, InputProgram, InputRelationApplyAtom, InputRuleApplyAtom, QueryAssertion, QueryOutOptions, RelationOp, ReturnMutation, SearchInput, SortDir, Unification};
+use crate::data::program::{AccumOp, FixedRuleApply, FixedRuleArg, InputAtom, InputInlineRule, InputInlineRulesOrFixed, InputNamedFieldRelationApplyAtom, InputProgram, InputRelationApplyAtom, InputRuleApplyAtom, QueryAssertion, QueryOutOptions, RelationOp, ReturnMutation, SearchInput, SortDir, Unification};
 use crate::data::relation::{ColType, ColumnDef, NullableColType, StoredRelationMetadata};
 use crate::data::symb::{Symbol, PROG_ENTRY};
 use crate::data::value::{DataValue, ValidityTs};
@@ -107,6 +107,7 @@ pub(crate) fn parse_query(
     let mut progs: BTreeMap<Symbol, InputInlineRulesOrFixed> = Default::default();
     let mut out_opts: QueryOutOptions = Default::default();
     let mut disable_magic_rewrite = false;
+    let mut reorder_relations = false;
 
     let mut stored_relation = None;
     let mut returning_mutation = ReturnMutation::NotReturning;
@@ -313,7 +314,8 @@ pub(crate) fn parse_query(
             Rule::relation_option => {
                 let span = pair.extract_span();
                 let mut args = pair.into_inner();
-                let op = match args.next().unwrap().as_rule() {
+                let op_p = args.next().unwrap();
+                let op = match op_p.as_rule() {
                     Rule::relation_create => RelationOp::Create,
                     Rule::relation_replace => RelationOp::Replace,
                     Rule::relation_put => RelationOp::Put,
@@ -323,6 +325,16 @@ pub(crate) fn parse_query(
                     Rule::relation_delete => RelationOp::Delete,
                     Rule::relation_ensure => RelationOp::Ensure,
                     Rule::relation_ensure_not => RelationOp::EnsureNot,
+                    Rule::relation_accumulate => {
+                        RelationOp::Accumulate(match op_p.into_inner().next().unwrap().as_str() {
+                            "sum" => AccumOp::Sum,
+                            "count" => AccumOp::Count,
+                            "min" => AccumOp::Min,
+                            "max" => AccumOp::Max,
+                            "bit_or" => AccumOp::BitOr,
+                            _ => unreachable!(),
+                        })
+                    }
                     _ => unreachable!(),
                 };
 
@@ -376,6 +388,16 @@ pub(crate) fn parse_query(
                     .ok_or(OptionNotBoolError("disable_magic_rewrite", span))?;
                 disable_magic_rewrite = val;
             }
+            Rule::reorder_relations_option => {
+                let pair = pair.into_inner().next().unwrap();
+                let span = pair.extract_span();
+                let val = build_expr(pair, param_pool)?
+                    .eval_to_const()
+                    .map_err(|err| OptionNotConstantError("reorder_relations", span, [err]))?
+                    .get_bool()
+                    .ok_or(OptionNotBoolError("reorder_relations", span))?;
+                reorder_relations = val;
+            }
             Rule::EOI => break,
             r => unreachable!("{:?}", r),
         }
@@ -385,6 +407,7 @@ pub(crate) fn parse_query(
         prog: progs,
         out_opts,
         disable_magic_rewrite,
+        reorder_relations,
     };
 
     if prog.prog.is_empty() {
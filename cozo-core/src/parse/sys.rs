@@ -29,6 +29,8 @@ use crate::{Expr, FixedRule};
 #[derive(Debug)]
 pub(crate) enum SysOp {
     Compact,
+    StorageStats,
+    RelationStats,
     ListColumns(Symbol),
     ListIndices(Symbol),
     ListRelations,
@@ -36,11 +38,13 @@ pub(crate) enum SysOp {
     ListFixedRules,
     KillRunning(u64),
     Explain(Box<InputProgram>),
+    Analyze(Box<InputProgram>),
     RemoveRelation(Vec<Symbol>),
     RenameRelation(Vec<(Symbol, Symbol)>),
     ShowTrigger(Symbol),
     SetTriggers(Symbol, Vec<String>, Vec<String>, Vec<String>),
     SetAccessLevel(Vec<Symbol>, AccessLevel),
+    SetRetention(Symbol, Option<i64>),
     CreateIndex(Symbol, Symbol, Vec<Symbol>),
     CreateVectorIndex(HnswIndexConfig),
     CreateFtsIndex(FtsIndexConfig),
@@ -110,6 +114,8 @@ pub(crate) fn parse_sys(
     let inner = src.next().unwrap();
     Ok(match inner.as_rule() {
         Rule::compact_op => SysOp::Compact,
+        Rule::storage_stats_op => SysOp::StorageStats,
+        Rule::relation_stats_op => SysOp::RelationStats,
         Rule::running_op => SysOp::ListRunning,
         Rule::kill_op => {
             let i_expr = inner.into_inner().next().unwrap();
@@ -129,6 +135,15 @@ pub(crate) fn parse_sys(
             )?;
             SysOp::Explain(Box::new(prog))
         }
+        Rule::analyze_op => {
+            let prog = parse_query(
+                inner.into_inner().next().unwrap().into_inner(),
+                param_pool,
+                algorithms,
+                cur_vld,
+            )?;
+            SysOp::Analyze(Box::new(prog))
+        }
         Rule::describe_relation_op => {
             let mut inner = inner.into_inner();
             let rels_p = inner.next().unwrap();
@@ -188,6 +203,23 @@ pub(crate) fn parse_sys(
             }
             SysOp::SetAccessLevel(rels, access_level)
         }
+        Rule::retention_op => {
+            let mut ps = inner.into_inner();
+            let rel_p = ps.next().unwrap();
+            let rel = Symbol::new(rel_p.as_str(), rel_p.extract_span());
+            let secs = build_expr(ps.next().unwrap(), param_pool)?.eval_to_const()?;
+            let retention_micros = match secs {
+                DataValue::Null => None,
+                v => {
+                    let secs = v
+                        .get_float()
+                        .ok_or_else(|| miette!("Retention must be a number of seconds, or null"))?;
+                    ensure!(secs >= 0., "Retention must not be negative");
+                    Some((secs * 1_000_000.) as i64)
+                }
+            };
+            SysOp::SetRetention(rel, retention_micros)
+        }
         Rule::trigger_relation_show_op => {
             let rels_p = inner.into_inner().next().unwrap();
             let rel = Symbol::new(rels_p.as_str(), rels_p.extract_span());
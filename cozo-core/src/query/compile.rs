@@ -264,8 +264,11 @@ impl<'a> SessionTx<'a> {
                         }
                     }
 
-                    let chosen_index =
-                        store.choose_index(&join_indices, rel_app.valid_at.is_some());
+                    let chosen_index = store.choose_index(
+                        &join_indices,
+                        rel_app.valid_at.is_some(),
+                        self.estimated_rows(&store),
+                    );
 
                     match chosen_index {
                         None => {
@@ -433,8 +436,11 @@ impl<'a> SessionTx<'a> {
                         }
                     }
 
-                    let chosen_index =
-                        store.choose_index(&join_indices, rel_app.valid_at.is_some());
+                    let chosen_index = store.choose_index(
+                        &join_indices,
+                        rel_app.valid_at.is_some(),
+                        self.estimated_rows(&store),
+                    );
 
                     match chosen_index {
                         None | Some((_, _, true)) => {
@@ -30,6 +30,9 @@ use crate::runtime::temp_store::EpochStore;
 use crate::runtime::transact::SessionTx;
 use crate::utils::swap_option_result;
 
+/// Number of left tuples sent to the storage in one batch by point-lookup joins.
+const POINT_LOOKUP_BATCH_SIZE: usize = 256;
+
 pub(crate) enum RelAlgebra {
     Fixed(InlineFixedRA),
     TempStore(TempStoreRA),
@@ -1268,68 +1271,70 @@ impl StoredRA {
         let val_len = self.storage.metadata.non_keys.len();
         let all_right_val_indices: BTreeSet<usize> =
             (0..val_len).map(|i| left_tuple_len + key_len + i).collect();
+        let keys_only =
+            self.filters.is_empty() && eliminate_indices.is_superset(&all_right_val_indices);
         let mut stack = vec![];
-        if self.filters.is_empty() && eliminate_indices.is_superset(&all_right_val_indices) {
-            let it = left_iter
-                .map_ok(move |tuple| -> Result<Option<Tuple>> {
-                    let prefix = left_to_prefix_indices
-                        .iter()
-                        .map(|i| tuple[*i].clone())
-                        .collect_vec();
-                    let key = &prefix[0..key_len];
-                    for (p, span) in self.filters_bytecodes.iter() {
-                        if !eval_bytecode_pred(p, key, &mut stack, *span)? {
-                            return Ok(None);
+        // Left tuples are looked up in batches so that the storage can coalesce the reads.
+        let it = left_iter
+            .batching(|it| {
+                let batch = it.take(POINT_LOOKUP_BATCH_SIZE).collect_vec();
+                if batch.is_empty() {
+                    None
+                } else {
+                    Some(batch)
+                }
+            })
+            .map(move |batch| -> Result<Vec<Tuple>> {
+                let batch: Vec<Tuple> = batch.into_iter().try_collect()?;
+                let keys = batch
+                    .iter()
+                    .map(|tuple| {
+                        left_to_prefix_indices[0..key_len]
+                            .iter()
+                            .map(|i| tuple[*i].clone())
+                            .collect_vec()
+                    })
+                    .collect_vec();
+                let key_refs = keys.iter().map(|k| k.as_slice()).collect_vec();
+                let mut ret = Vec::with_capacity(batch.len());
+                if keys_only {
+                    // Only presence matters here, so the values are not fetched at all.
+                    let found = self.storage.multi_exists(tx, &key_refs)?;
+                    for ((tuple, key), found) in batch.into_iter().zip(keys).zip(found) {
+                        if found {
+                            let mut joined = tuple;
+                            joined.extend(key);
+                            for _ in 0..val_len {
+                                joined.push(DataValue::Bot);
+                            }
+                            ret.push(joined);
                         }
                     }
-                    if self.storage.exists(tx, key)? {
-                        let mut ret = tuple;
-                        ret.extend_from_slice(key);
-                        for _ in 0..val_len {
-                            ret.push(DataValue::Bot);
+                    return Ok(ret);
+                }
+                let found = self.storage.multi_get(tx, &key_refs)?;
+                'outer: for (tuple, found) in batch.into_iter().zip(found) {
+                    let found = match found {
+                        None => continue,
+                        Some(found) => found,
+                    };
+                    for (p, span) in self.filters_bytecodes.iter() {
+                        if !eval_bytecode_pred(p, &found, &mut stack, *span)? {
+                            continue 'outer;
                         }
-                        Ok(Some(ret))
-                    } else {
-                        Ok(None)
                     }
-                })
-                .flatten_ok()
-                .filter_map(invert_option_err);
-            Ok(if eliminate_indices.is_empty() {
-                Box::new(it)
-            } else {
-                Box::new(it.map_ok(move |t| eliminate_from_tuple(t, &eliminate_indices)))
+                    let mut joined = tuple;
+                    joined.extend(found);
+                    ret.push(joined);
+                }
+                Ok(ret)
             })
+            .flatten_ok();
+        Ok(if eliminate_indices.is_empty() {
+            Box::new(it)
         } else {
-            let it = left_iter
-                .map_ok(move |tuple| -> Result<Option<Tuple>> {
-                    let prefix = left_to_prefix_indices
-                        .iter()
-                        .map(|i| tuple[*i].clone())
-                        .collect_vec();
-                    let key = &prefix[0..key_len];
-                    match self.storage.get(tx, key)? {
-                        None => Ok(None),
-                        Some(found) => {
-                            for (p, span) in self.filters_bytecodes.iter() {
-                                if !eval_bytecode_pred(p, &found, &mut stack, *span)? {
-                                    return Ok(None);
-                                }
-                            }
-                            let mut ret = tuple;
-                            ret.extend(found);
-                            Ok(Some(ret))
-                        }
-                    }
-                })
-                .flatten_ok()
-                .filter_map(invert_option_err);
-            Ok(if eliminate_indices.is_empty() {
-                Box::new(it)
-            } else {
-                Box::new(it.map_ok(move |t| eliminate_from_tuple(t, &eliminate_indices)))
-            })
-        }
+            Box::new(it.map_ok(move |t| eliminate_from_tuple(t, &eliminate_indices)))
+        })
     }
 
     fn prefix_join<'a>(
@@ -12,8 +12,10 @@ use std::mem;
 use miette::{bail, Diagnostic, Result};
 use thiserror::Error;
 
-use crate::data::program::{NormalFormAtom, NormalFormInlineRule};
+use crate::data::program::{NormalFormAtom, NormalFormInlineRule, NormalFormRelationApplyAtom};
+use crate::data::symb::Symbol;
 use crate::parse::SourceSpan;
+use crate::runtime::transact::SessionTx;
 
 #[derive(Diagnostic, Debug, Error)]
 #[error("Encountered unsafe negation, or empty rule definition")]
@@ -31,7 +33,11 @@ pub(crate) struct UnsafeNegation(#[label] pub(crate) SourceSpan);
 pub(crate) struct UnboundVariable(#[label] pub(crate) SourceSpan);
 
 impl NormalFormInlineRule {
-    pub(crate) fn convert_to_well_ordered_rule(self) -> Result<Self> {
+    pub(crate) fn convert_to_well_ordered_rule(
+        self,
+        tx: &SessionTx<'_>,
+        reorder_relations: bool,
+    ) -> Result<Self> {
         let mut seen_variables = BTreeSet::default();
         let mut round_1_collected = vec![];
         let mut pending = vec![];
@@ -99,6 +105,12 @@ impl NormalFormInlineRule {
             }
         }
 
+        let round_1_collected = if reorder_relations {
+            reorder_stored_relations(round_1_collected, tx)
+        } else {
+            round_1_collected
+        };
+
         let mut collected = vec![];
         seen_variables.clear();
         let mut last_pending = vec![];
@@ -240,3 +252,92 @@ impl NormalFormInlineRule {
         })
     }
 }
+
+fn bound_by_atom(atom: &NormalFormAtom, seen_variables: &mut BTreeSet<Symbol>) {
+    match atom {
+        NormalFormAtom::Rule(r) => seen_variables.extend(r.args.iter().cloned()),
+        NormalFormAtom::Relation(v) => seen_variables.extend(v.args.iter().cloned()),
+        NormalFormAtom::Unification(u) => {
+            seen_variables.insert(u.binding.clone());
+        }
+        NormalFormAtom::HnswSearch(s) => seen_variables.extend(s.all_bindings().cloned()),
+        NormalFormAtom::FtsSearch(s) => seen_variables.extend(s.all_bindings().cloned()),
+        NormalFormAtom::LshSearch(s) => seen_variables.extend(s.all_bindings().cloned()),
+        NormalFormAtom::NegatedRule(_)
+        | NormalFormAtom::NegatedRelation(_)
+        | NormalFormAtom::Predicate(_) => {}
+    }
+}
+
+/// Reorders each run of consecutive stored relation applications greedily, so that the atom
+/// expected to produce the fewest rows is joined next: a relation whose first key is already
+/// bound costs a prefix lookup returning the average number of rows per first key, any other
+/// costs a scan of its estimated size. Atoms sharing
+/// variables with what is already bound are preferred over cartesian products, and ties keep
+/// the order as written. A run is left alone unless every relation in it has a row estimate,
+/// which only storage engines able to approximate sizes without scanning provide.
+/// Only done when asked for with `:reorder_relations`.
+fn reorder_stored_relations(atoms: Vec<NormalFormAtom>, tx: &SessionTx<'_>) -> Vec<NormalFormAtom> {
+    let mut seen_variables = BTreeSet::default();
+    let mut ret = Vec::with_capacity(atoms.len());
+    let mut run: Vec<NormalFormRelationApplyAtom> = vec![];
+    for atom in atoms {
+        match atom {
+            NormalFormAtom::Relation(v) => run.push(v),
+            atom => {
+                flush_relation_run(&mut run, &mut seen_variables, &mut ret, tx);
+                bound_by_atom(&atom, &mut seen_variables);
+                ret.push(atom);
+            }
+        }
+    }
+    flush_relation_run(&mut run, &mut seen_variables, &mut ret, tx);
+    ret
+}
+
+fn flush_relation_run(
+    run: &mut Vec<NormalFormRelationApplyAtom>,
+    seen_variables: &mut BTreeSet<Symbol>,
+    ret: &mut Vec<NormalFormAtom>,
+    tx: &SessionTx<'_>,
+) {
+    let mut pending = mem::take(run);
+    let estimates = if pending.len() > 1 {
+        pending
+            .iter()
+            .map(|v| tx.planner_estimates(&v.name))
+            .collect::<Option<Vec<_>>>()
+    } else {
+        None
+    };
+    let mut estimates = match estimates {
+        Some(estimates) => estimates,
+        None => {
+            for v in pending {
+                seen_variables.extend(v.args.iter().cloned());
+                ret.push(NormalFormAtom::Relation(v));
+            }
+            return;
+        }
+    };
+    while !pending.is_empty() {
+        let mut best = 0;
+        let mut best_key = (true, usize::MAX);
+        for (i, v) in pending.iter().enumerate() {
+            let connected =
+                seen_variables.is_empty() || v.args.iter().any(|a| seen_variables.contains(a));
+            let key_bound = v.args.first().map_or(false, |a| seen_variables.contains(a));
+            let (rows, rows_per_key) = estimates[i];
+            let cost = if key_bound { rows_per_key } else { rows };
+            let key = (!connected, cost);
+            if key < best_key {
+                best = i;
+                best_key = key;
+            }
+        }
+        let v = pending.remove(best);
+        estimates.remove(best);
+        seen_variables.extend(v.args.iter().cloned());
+        ret.push(NormalFormAtom::Relation(v));
+    }
+}
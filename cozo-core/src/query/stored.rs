@@ -10,17 +10,20 @@ use std::collections::{BTreeMap, BTreeSet};
 use std::sync::Arc;
 
 use itertools::Itertools;
-use miette::{bail, Diagnostic, IntoDiagnostic, Result, WrapErr};
+use miette::{bail, miette, Diagnostic, IntoDiagnostic, Result, WrapErr};
 use pest::Parser;
 use smartstring::{LazyCompact, SmartString};
 use thiserror::Error;
 
 use crate::data::expr::{Bytecode, Expr};
-use crate::data::program::{FixedRuleApply, InputInlineRulesOrFixed, InputProgram, RelationOp};
+use crate::data::functions::op_bit_or;
+use crate::data::program::{
+    AccumOp, FixedRuleApply, InputInlineRulesOrFixed, InputProgram, RelationOp,
+};
 use crate::data::relation::{ColumnDef, NullableColType, StoredRelationMetadata};
 use crate::data::symb::Symbol;
 use crate::data::tuple::{Tuple, ENCODED_KEY_MIN_LEN};
-use crate::data::value::{DataValue, ValidityTs};
+use crate::data::value::{DataValue, Num, ValidityTs};
 use crate::fixed_rule::utilities::constant::Constant;
 use crate::fixed_rule::FixedRuleHandle;
 use crate::fts::tokenizer::TextAnalyzer;
@@ -182,6 +185,22 @@ impl<'a> SessionTx<'a> {
                 force_collect,
                 *span,
             )?,
+            RelationOp::Accumulate(accum_op) => self.accumulate_in_relation(
+                db,
+                res_iter,
+                headers,
+                cur_vld,
+                callback_targets,
+                callback_collector,
+                propagate_triggers,
+                &mut to_clear,
+                &relation_store,
+                metadata,
+                key_bindings,
+                accum_op,
+                force_collect,
+                *span,
+            )?,
             RelationOp::Create | RelationOp::Replace | RelationOp::Put | RelationOp::Insert => self
                 .put_into_relation(
                     db,
@@ -666,6 +685,154 @@ impl<'a> SessionTx<'a> {
         Ok(())
     }
 
+    /// Combines the given non-key values with those of the stored rows. Rows that do not exist
+    /// yet are created, with the columns not given taking their defaults. When nothing needs the
+    /// old rows, and the storage engine supports merges, merge operands are written blindly
+    /// without reading or locking the rows. Otherwise rows are read, combined and written back.
+    fn accumulate_in_relation<'s, S: Storage<'s>>(
+        &mut self,
+        db: &Db<S>,
+        res_iter: impl Iterator<Item = Tuple>,
+        headers: &[Symbol],
+        cur_vld: ValidityTs,
+        callback_targets: &BTreeSet<SmartString<LazyCompact>>,
+        callback_collector: &mut CallbackCollector,
+        propagate_triggers: bool,
+        to_clear: &mut Vec<(Vec<u8>, Vec<u8>)>,
+        relation_store: &RelationHandle,
+        metadata: &StoredRelationMetadata,
+        key_bindings: &[Symbol],
+        accum_op: AccumOp,
+        force_collect: &str,
+        span: SourceSpan,
+    ) -> Result<()> {
+        let is_callback_target = callback_targets.contains(&relation_store.name)
+            || force_collect == &relation_store.name;
+
+        if relation_store.access_level < AccessLevel::Protected {
+            bail!(InsufficientAccessLevel(
+                relation_store.name.to_string(),
+                "row accumulation".to_string(),
+                relation_store.access_level
+            ));
+        }
+
+        let key_extractors = make_extractors(
+            &relation_store.metadata.keys,
+            &metadata.keys,
+            key_bindings,
+            headers,
+        )?;
+        let val_extractors = make_extractors(
+            &relation_store.metadata.non_keys,
+            &metadata.keys,
+            key_bindings,
+            headers,
+        )?;
+        let accumulated = relation_store
+            .metadata
+            .non_keys
+            .iter()
+            .map(|col| metadata.keys.iter().any(|given| given.name == col.name))
+            .collect_vec();
+        if !accumulated.contains(&true) {
+            #[derive(Debug, Error, Diagnostic)]
+            #[error("no non-key column of relation {0} is given to accumulate into")]
+            #[diagnostic(code(eval::nothing_to_accumulate))]
+            struct NothingToAccumulate(String, #[label] SourceSpan);
+            bail!(NothingToAccumulate(relation_store.name.to_string(), span))
+        }
+
+        let need_to_collect = !force_collect.is_empty()
+            || (!relation_store.is_temp
+                && (is_callback_target
+                    || (propagate_triggers && !relation_store.put_triggers.is_empty())));
+        let blind = !relation_store.is_temp
+            && !need_to_collect
+            && relation_store.has_no_index()
+            && self.store_tx.supports_merge();
+
+        // encoded key -> (key columns, merged value), for writing back when not blind
+        let mut merged_rows: BTreeMap<Vec<u8>, (Tuple, Vec<u8>)> = BTreeMap::new();
+
+        for tuple in res_iter {
+            let key_tuple: Tuple = key_extractors
+                .iter()
+                .map(|ex| ex.extract_data(&tuple, cur_vld))
+                .try_collect()?;
+            let mut vals: Tuple = val_extractors
+                .iter()
+                .map(|ex| ex.extract_data(&tuple, cur_vld))
+                .try_collect()?;
+            let op = prepare_accumulated(relation_store, accum_op, &mut vals, &accumulated)?;
+
+            let key = relation_store.encode_key_for_store(&key_tuple, span)?;
+            let operand = relation_store.encode_accum_operand_for_store(op, &vals, &accumulated);
+
+            if blind {
+                self.store_tx.merge(&key, &operand)?;
+                continue;
+            }
+
+            let existing = match merged_rows.remove(&key) {
+                Some((_, val)) => Some(val),
+                None => {
+                    if relation_store.is_temp {
+                        self.temp_store_tx.get(&key, true)?
+                    } else {
+                        self.store_tx.get(&key, true)?
+                    }
+                }
+            };
+            let merged = merge_accumulated(existing.as_deref(), &[&operand]).ok_or_else(|| {
+                miette!("cannot accumulate into a row of {}", relation_store.name)
+            })?;
+            merged_rows.insert(key, (key_tuple, merged));
+        }
+
+        if merged_rows.is_empty() {
+            return Ok(());
+        }
+
+        // Writing the combined rows as puts takes care of indices, triggers and callbacks
+        let all_cols = StoredRelationMetadata {
+            keys: relation_store
+                .metadata
+                .keys
+                .iter()
+                .chain(relation_store.metadata.non_keys.iter())
+                .cloned()
+                .collect_vec(),
+            non_keys: vec![],
+        };
+        let all_bindings = all_cols
+            .keys
+            .iter()
+            .map(|col| Symbol::new(col.name.clone(), span))
+            .collect_vec();
+        let rows = merged_rows.into_values().map(|(mut row, val)| {
+            extend_tuple_from_v(&mut row, &val);
+            row
+        });
+        self.put_into_relation(
+            db,
+            rows,
+            &all_bindings,
+            cur_vld,
+            callback_targets,
+            callback_collector,
+            propagate_triggers,
+            to_clear,
+            relation_store,
+            &all_cols,
+            &all_bindings,
+            &[],
+            false,
+            force_collect,
+            span,
+        )
+    }
+
     fn collect_mutations<'s, S: Storage<'s>>(
         &mut self,
         db: &Db<S>,
@@ -1116,6 +1283,132 @@ struct TransactAssertionFailure {
     notice: String,
 }
 
+/// Checks the values given to `:accumulate`, returning the operation to store with them.
+/// `count` is stored as a sum of ones.
+fn prepare_accumulated(
+    relation_store: &RelationHandle,
+    op: AccumOp,
+    vals: &mut [DataValue],
+    accumulated: &[bool],
+) -> Result<AccumOp> {
+    #[derive(Debug, Error, Diagnostic)]
+    #[error("cannot accumulate {value:?} into column {column} of {relation} with '{op}'")]
+    #[diagnostic(code(eval::bad_accumulate_value))]
+    #[diagnostic(help("'sum' needs numbers and 'bit_or' needs bytes"))]
+    struct BadAccumulateValue {
+        relation: String,
+        column: String,
+        value: DataValue,
+        op: AccumOp,
+    }
+
+    for ((val, acc), col) in vals
+        .iter_mut()
+        .zip(accumulated)
+        .zip(relation_store.metadata.non_keys.iter())
+    {
+        if !*acc {
+            continue;
+        }
+        let ok = match op {
+            AccumOp::Count => {
+                *val = DataValue::from(1);
+                true
+            }
+            AccumOp::Sum => matches!(val, DataValue::Num(_)),
+            AccumOp::BitOr => matches!(val, DataValue::Bytes(_)),
+            AccumOp::Min | AccumOp::Max => true,
+        };
+        if !ok {
+            bail!(BadAccumulateValue {
+                relation: relation_store.name.to_string(),
+                column: col.name.to_string(),
+                value: val.clone(),
+                op,
+            })
+        }
+    }
+    Ok(if op == AccumOp::Count {
+        AccumOp::Sum
+    } else {
+        op
+    })
+}
+
+/// Combines a stored non-key value with operands written by `:accumulate`, in the order they
+/// were written. Serves as the merge function of storage engines supporting merges.
+/// Returns `None` if the stored value or the operands cannot be decoded, or if their numbers of
+/// columns differ: schemas never change in place, so this can only come from corrupt data.
+pub(crate) fn merge_accumulated(existing: Option<&[u8]>, operands: &[&[u8]]) -> Option<Vec<u8>> {
+    let mut row: Option<Tuple> = match existing {
+        Some(v) if v.len() > ENCODED_KEY_MIN_LEN => {
+            Some(rmp_serde::from_slice(&v[ENCODED_KEY_MIN_LEN..]).ok()?)
+        }
+        _ => None,
+    };
+    let mut prefix = existing.and_then(|v| v.get(..ENCODED_KEY_MIN_LEN));
+    for operand in operands {
+        let (op, vals, accumulated): (AccumOp, Tuple, Vec<bool>) =
+            rmp_serde::from_slice(operand.get(ENCODED_KEY_MIN_LEN..)?).ok()?;
+        prefix = Some(&operand[..ENCODED_KEY_MIN_LEN]);
+        if vals.len() != accumulated.len() {
+            return None;
+        }
+        row = Some(match row {
+            Some(mut row) => {
+                if row.len() != vals.len() {
+                    return None;
+                }
+                for ((old, new), acc) in row.iter_mut().zip(vals).zip(accumulated) {
+                    if acc {
+                        *old = accumulate_value(op, old, new);
+                    }
+                }
+                row
+            }
+            None => vals,
+        });
+    }
+    let mut ret = prefix?.to_vec();
+    ret.extend(rmp_serde::to_vec(&row?).ok()?);
+    Some(ret)
+}
+
+/// Never fails, since it may run inside the storage engine: values that cannot be combined,
+/// which can only come from rows written by other means, are replaced by the new value.
+/// Integer sums saturate instead of overflowing, so that the column keeps its type.
+fn accumulate_value(op: AccumOp, old: &DataValue, new: DataValue) -> DataValue {
+    if *old == DataValue::Null {
+        return new;
+    }
+    match op {
+        AccumOp::Sum | AccumOp::Count => match (old, new) {
+            (DataValue::Num(Num::Int(a)), DataValue::Num(Num::Int(b))) => {
+                DataValue::from(a.saturating_add(b))
+            }
+            (DataValue::Num(a), DataValue::Num(b)) => {
+                DataValue::from(a.get_float() + b.get_float())
+            }
+            (_, new) => new,
+        },
+        AccumOp::Min => {
+            if new < *old {
+                new
+            } else {
+                old.clone()
+            }
+        }
+        AccumOp::Max => {
+            if new > *old {
+                new
+            } else {
+                old.clone()
+            }
+        }
+        AccumOp::BitOr => op_bit_or(&[old.clone(), new.clone()]).unwrap_or(new),
+    }
+}
+
 enum DataExtractor {
     DefaultExtractor(Expr, NullableColType),
     IndexExtractor(usize, NullableColType),
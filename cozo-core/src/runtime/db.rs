@@ -56,7 +56,7 @@ use crate::runtime::relation::{
 };
 use crate::runtime::transact::SessionTx;
 use crate::storage::temp::TempStorage;
-use crate::storage::Storage;
+use crate::storage::{LoggedOp, RelationStats, Storage};
 use crate::{decode_tuple_from_kv, FixedRule, Symbol};
 
 pub(crate) struct RunningQueryHandle {
@@ -125,6 +125,34 @@ pub(crate) struct BadDbInit(#[help] pub(crate) String);
 #[diagnostic(code(tx::import_into_index))]
 pub(crate) struct ImportIntoIndex(pub(crate) String);
 
+/// Kinds of changes to stored relations, see [ChangeEvent].
+#[derive(Copy, Clone, Debug, Eq, PartialEq)]
+pub enum ChangeOp {
+    /// A row was put
+    Put,
+    /// A row was removed
+    Rm,
+    /// A row was combined with an operand by `:accumulate`
+    Merge,
+    /// All rows of the relation were removed, as when it is destroyed
+    Drop,
+}
+
+/// A change to a stored relation read back from the log of the storage engine,
+/// see [Db::changes_since].
+#[derive(Clone, Debug)]
+pub struct ChangeEvent {
+    /// Sequence number of the change. Pass the last one seen plus one to resume.
+    pub seq: u64,
+    /// Id of the relation, which stays unique after the relation is destroyed
+    pub relation_id: u64,
+    /// `None` if the relation no longer exists, in which case only its drops are reported
+    pub relation: Option<String>,
+    pub op: ChangeOp,
+    /// The row for puts, only its key columns otherwise, and nothing for drops
+    pub tuple: Tuple,
+}
+
 #[derive(serde_derive::Serialize, serde_derive::Deserialize, Debug, Clone, Default)]
 /// Rows in a relation, together with headers for the fields.
 pub struct NamedRows {
@@ -261,6 +289,11 @@ impl<'s, S: Storage<'s>> Db<S> {
         Ok(ret)
     }
 
+    /// The storage engine of the database, for working with it directly.
+    pub fn storage(&self) -> &S {
+        &self.db
+    }
+
     /// Must be called after creation of the database to initialize the runtime state.
     pub fn initialize(&'s self) -> Result<()> {
         self.load_last_ids()?;
@@ -317,6 +350,8 @@ impl<'s, S: Storage<'s>> Db<S> {
                     break;
                 }
                 TransactionPayload::Abort => {
+                    // Rolled back before replying, so that the caller sees the effects
+                    drop(tx);
                     let _ = results.send(Ok(NamedRows::default()));
                     break;
                 }
@@ -613,34 +648,57 @@ impl<'s, S: Storage<'s>> Db<S> {
         #[cfg(not(feature = "storage-sqlite"))]
         bail!("backup requires the 'storage-sqlite' feature to be enabled")
     }
-    /// Restore from an Sqlite backup
+    /// Write a copy of the running database into the directory `out_dir`, which must not exist,
+    /// in the format of the storage engine, sharing immutable files with the database where
+    /// possible. Unlike [Db::backup_db], this is fast for large databases, but the copy can only be
+    /// opened by the same engine. [Db::restore_backup] and [Db::import_from_backup] accept it
+    /// too. Only the RocksDB engine supports this.
+    pub fn checkpoint_db(&'s self, out_dir: impl AsRef<Path>) -> Result<()> {
+        if !self.db.checkpoint(out_dir.as_ref())? {
+            bail!(
+                "the {} storage engine cannot write checkpoints",
+                self.db.storage_kind()
+            )
+        }
+        Ok(())
+    }
+    /// Restore from a backup: an Sqlite file, or a RocksDB checkpoint directory
     #[allow(unused_variables)]
     pub fn restore_backup(&'s self, in_file: impl AsRef<Path>) -> Result<()> {
+        #[cfg(feature = "storage-rocksdb")]
+        if in_file.as_ref().is_dir() {
+            let source_db = open_checkpoint(in_file.as_ref())?;
+            return self.restore_from(source_db.transact()?);
+        }
         #[cfg(feature = "storage-sqlite")]
         {
             let sqlite_db = crate::new_cozo_sqlite(in_file)?;
-            let mut s_tx = sqlite_db.transact()?;
-            {
-                let mut tx = self.transact()?;
-                let store_id = tx.relation_store_id.load(Ordering::SeqCst);
-                if store_id != 0 {
-                    bail!(
-                        "Cannot restore backup: data exists in the current database. \
-                You can only restore into a new database (store id: {}).",
-                        store_id
-                    );
-                }
-                tx.commit_tx()?;
-            }
-            let iter = s_tx.store_tx.total_scan();
-            self.db.batch_put(iter)?;
-            s_tx.commit_tx()?;
-            Ok(())
+            self.restore_from(sqlite_db.transact()?)
         }
         #[cfg(not(feature = "storage-sqlite"))]
         bail!("backup requires the 'storage-sqlite' feature to be enabled")
     }
-    /// Import data from relations in a backup file.
+    #[cfg(any(feature = "storage-sqlite", feature = "storage-rocksdb"))]
+    fn restore_from(&'s self, mut s_tx: SessionTx<'_>) -> Result<()> {
+        {
+            let mut tx = self.transact()?;
+            let store_id = tx.relation_store_id.load(Ordering::SeqCst);
+            if store_id != 0 {
+                bail!(
+                    "Cannot restore backup: data exists in the current database. \
+            You can only restore into a new database (store id: {}).",
+                    store_id
+                );
+            }
+            tx.commit_tx()?;
+        }
+        let iter = s_tx.store_tx.total_scan();
+        self.db.batch_put(iter)?;
+        s_tx.commit_tx()?;
+        Ok(())
+    }
+    /// Import data from relations in a backup, which is an Sqlite file or a RocksDB checkpoint
+    /// directory.
     /// The target stored relations must already exist in the database, and it must not
     /// have any associated indices. If you want to import into relations with indices,
     /// use [Db::import_relations].
@@ -653,64 +711,164 @@ impl<'s, S: Storage<'s>> Db<S> {
         in_file: impl AsRef<Path>,
         relations: &[String],
     ) -> Result<()> {
+        #[cfg(feature = "storage-rocksdb")]
+        if in_file.as_ref().is_dir() {
+            let source_db = open_checkpoint(in_file.as_ref())?;
+            return self.import_from(source_db.transact()?, relations);
+        }
         #[cfg(not(feature = "storage-sqlite"))]
         bail!("backup requires the 'storage-sqlite' feature to be enabled");
 
         #[cfg(feature = "storage-sqlite")]
         {
-            let rel_names = relations.iter().map(SmartString::from).collect_vec();
-            let locks = self.obtain_relation_locks(rel_names.iter());
-            let _guards = locks.iter().map(|l| l.read().unwrap()).collect_vec();
-
             let source_db = crate::new_cozo_sqlite(in_file)?;
-            let mut src_tx = source_db.transact()?;
-            let mut dst_tx = self.transact_write()?;
+            self.import_from(source_db.transact()?, relations)
+        }
+    }
+    #[cfg(any(feature = "storage-sqlite", feature = "storage-rocksdb"))]
+    fn import_from(&'s self, mut src_tx: SessionTx<'_>, relations: &[String]) -> Result<()> {
+        let rel_names = relations.iter().map(SmartString::from).collect_vec();
+        let locks = self.obtain_relation_locks(rel_names.iter());
+        let _guards = locks.iter().map(|l| l.read().unwrap()).collect_vec();
 
-            for relation in relations {
-                if relation.contains(':') {
-                    bail!(ImportIntoIndex(relation.to_string()))
-                }
-                let src_handle = src_tx.get_relation(relation, false)?;
-                let dst_handle = dst_tx.get_relation(relation, false)?;
+        let mut dst_tx = self.transact_write()?;
 
-                if !dst_handle.indices.is_empty() {
-                    #[derive(Debug, Error, Diagnostic)]
-                    #[error("Cannot import data into relation {0} from backup as the relation has indices")]
-                    #[diagnostic(code(tx::bare_import_with_indices))]
-                    #[diagnostic(help("Use `import_relations()` instead"))]
-                    pub(crate) struct RestoreIntoRelWithIndices(pub(crate) String);
+        for relation in relations {
+            if relation.contains(':') {
+                bail!(ImportIntoIndex(relation.to_string()))
+            }
+            let src_handle = src_tx.get_relation(relation, false)?;
+            let dst_handle = dst_tx.get_relation(relation, false)?;
 
-                    bail!(RestoreIntoRelWithIndices(dst_handle.name.to_string()))
-                }
+            if !dst_handle.indices.is_empty() {
+                #[derive(Debug, Error, Diagnostic)]
+                #[error(
+                    "Cannot import data into relation {0} from backup as the relation has indices"
+                )]
+                #[diagnostic(code(tx::bare_import_with_indices))]
+                #[diagnostic(help("Use `import_relations()` instead"))]
+                pub(crate) struct RestoreIntoRelWithIndices(pub(crate) String);
+
+                bail!(RestoreIntoRelWithIndices(dst_handle.name.to_string()))
+            }
 
-                if dst_handle.access_level < AccessLevel::Protected {
-                    bail!(InsufficientAccessLevel(
-                        dst_handle.name.to_string(),
-                        "data import".to_string(),
-                        dst_handle.access_level
-                    ));
-                }
+            if dst_handle.access_level < AccessLevel::Protected {
+                bail!(InsufficientAccessLevel(
+                    dst_handle.name.to_string(),
+                    "data import".to_string(),
+                    dst_handle.access_level
+                ));
+            }
 
-                let src_lower = Tuple::default().encode_as_key(src_handle.id);
-                let src_upper = Tuple::default().encode_as_key(src_handle.id.next());
+            let src_lower = Tuple::default().encode_as_key(src_handle.id);
+            let src_upper = Tuple::default().encode_as_key(src_handle.id.next());
 
-                let data_it = src_tx.store_tx.range_scan(&src_lower, &src_upper).map(
-                    |src_pair| -> Result<(Vec<u8>, Vec<u8>)> {
-                        let (mut src_k, mut src_v) = src_pair?;
-                        dst_handle.amend_key_prefix(&mut src_k);
-                        dst_handle.amend_key_prefix(&mut src_v);
-                        Ok((src_k, src_v))
-                    },
-                );
-                for result in data_it {
-                    let (key, val) = result?;
-                    dst_tx.store_tx.put(&key, &val)?;
-                }
+            let data_it = src_tx.store_tx.range_scan(&src_lower, &src_upper).map(
+                |src_pair| -> Result<(Vec<u8>, Vec<u8>)> {
+                    let (mut src_k, mut src_v) = src_pair?;
+                    dst_handle.amend_key_prefix(&mut src_k);
+                    dst_handle.amend_key_prefix(&mut src_v);
+                    Ok((src_k, src_v))
+                },
+            );
+            for result in data_it {
+                let (key, val) = result?;
+                dst_tx.store_tx.put(&key, &val)?;
             }
+        }
 
-            src_tx.commit_tx()?;
-            dst_tx.commit_tx()
+        src_tx.commit_tx()?;
+        dst_tx.commit_tx()
+    }
+    /// Up to `limit` changes to stored relations with sequence numbers from `seq` on, oldest
+    /// first, read back from the log kept by the storage engine. The log survives restarts,
+    /// so a consumer can resume from the last sequence number it has seen, as long as the
+    /// engine still retains that part of the log. Changes to indices and to hidden relations
+    /// are left out, as are rows of relations that no longer exist.
+    ///
+    /// Only the RocksDB engine keeps such a log, and by default only until the data is flushed:
+    /// see its `wal_ttl_seconds` and `wal_size_limit_mb` options. It is not available under its
+    /// `prepared` and `unprepared` write policies. Some writes bypass the log and produce
+    /// no changes at all: relations removed by dropping their own column family
+    /// (`relation_column_families`), restores ingesting SST files (`bulk_load_sst_threads`),
+    /// and bulk loads with `bulk_load_disable_wal`.
+    pub fn changes_since(&'s self, seq: u64, limit: usize) -> Result<Vec<ChangeEvent>> {
+        let writes = match self.db.logged_writes_since(seq, limit)? {
+            Some(writes) => writes,
+            None => bail!(
+                "the {} storage engine keeps no log of changes",
+                self.db.storage_kind()
+            ),
+        };
+
+        let mut tx = self.transact()?;
+        let mut relations = BTreeMap::new();
+        let mut index_ids = BTreeSet::new();
+        let mut hidden_ids = BTreeSet::new();
+        let lower = vec![DataValue::from("")].encode_as_key(RelationId::SYSTEM);
+        let upper =
+            vec![DataValue::from(String::from(LARGEST_UTF_CHAR))].encode_as_key(RelationId::SYSTEM);
+        for kv_res in tx.store_tx.range_scan(&lower, &upper) {
+            let (k_slice, v_slice) = kv_res?;
+            if upper <= k_slice {
+                break;
+            }
+            let meta = RelationHandle::decode(&v_slice)?;
+            index_ids.extend(meta.indices.values().map(|(h, _)| h.id.0));
+            index_ids.extend(meta.hnsw_indices.values().map(|(h, _)| h.id.0));
+            index_ids.extend(meta.fts_indices.values().map(|(h, _)| h.id.0));
+            index_ids.extend(
+                meta.lsh_indices
+                    .values()
+                    .flat_map(|(h, inv, _)| [h.id.0, inv.id.0]),
+            );
+            if meta.access_level < AccessLevel::ReadOnly {
+                hidden_ids.insert(meta.id.0);
+            } else {
+                relations.insert(meta.id.0, (meta.name.to_string(), meta.arity()));
+            }
         }
+        tx.commit_tx()?;
+
+        let mut ret = Vec::with_capacity(writes.len());
+        for write in writes {
+            let relation_id = match write.key.get(..8) {
+                Some(prefix) => u64::from_be_bytes(prefix.try_into().unwrap()),
+                None => continue,
+            };
+            if relation_id == RelationId::SYSTEM.0
+                || index_ids.contains(&relation_id)
+                || hidden_ids.contains(&relation_id)
+            {
+                continue;
+            }
+            // Whether a relation that no longer exists was hidden is not known
+            let (relation, arity) = match relations.get(&relation_id) {
+                Some((name, arity)) => (Some(name.clone()), Some(*arity)),
+                None if write.op == LoggedOp::DeleteRange => (None, None),
+                None => continue,
+            };
+            let (op, tuple) = match write.op {
+                LoggedOp::Put => (
+                    ChangeOp::Put,
+                    decode_tuple_from_kv(&write.key, &write.val, arity),
+                ),
+                LoggedOp::Delete => (ChangeOp::Rm, decode_tuple_from_kv(&write.key, &[], arity)),
+                LoggedOp::Merge => (
+                    ChangeOp::Merge,
+                    decode_tuple_from_kv(&write.key, &[], arity),
+                ),
+                LoggedOp::DeleteRange => (ChangeOp::Drop, vec![]),
+            };
+            ret.push(ChangeEvent {
+                seq: write.seq,
+                relation_id,
+                relation,
+                op,
+                tuple,
+            });
+        }
+        Ok(ret)
     }
     /// Register a custom fixed rule implementation.
     pub fn register_fixed_rule<R>(&self, name: String, rule_impl: R) -> Result<()>
@@ -822,6 +980,7 @@ impl<'s, S: Storage<'s>> Db<S> {
         let mut tx = self.transact_write()?;
         self.relation_store_id
             .store(tx.init_storage()?.0, Ordering::Release);
+        tx.load_relation_settings()?;
         tx.commit_tx()?;
         Ok(())
     }
@@ -832,6 +991,7 @@ impl<'s, S: Storage<'s>> Db<S> {
             relation_store_id: self.relation_store_id.clone(),
             temp_store_id: Default::default(),
             tokenizers: self.tokenizers.clone(),
+            planner_estimates: Default::default(),
         };
         Ok(ret)
     }
@@ -842,6 +1002,7 @@ impl<'s, S: Storage<'s>> Db<S> {
             relation_store_id: self.relation_store_id.clone(),
             temp_store_id: Default::default(),
             tokenizers: self.tokenizers.clone(),
+            planner_estimates: Default::default(),
         };
         Ok(ret)
     }
@@ -1178,6 +1339,40 @@ impl<'s, S: Storage<'s>> Db<S> {
                 let compiled = tx.stratified_magic_compile(program)?;
                 self.explain_compiled(&compiled)
             }
+            SysOp::Analyze(prog) => {
+                if prog.out_opts.store_relation.is_some() {
+                    bail!("Only queries that do not modify stored relations can be analyzed");
+                }
+                let started = seconds_since_the_epoch()?;
+                self.db.start_perf_counters();
+                let res = self.run_query(
+                    tx,
+                    *prog.clone(),
+                    current_validity(),
+                    &Default::default(),
+                    &mut Default::default(),
+                    true,
+                );
+                let counters = self.db.stop_perf_counters();
+                let took = seconds_since_the_epoch()? - started;
+                let (res, _) = res?;
+                let mut rows = vec![
+                    vec![
+                        DataValue::from("rows"),
+                        DataValue::from(res.rows.len() as i64),
+                    ],
+                    vec![DataValue::from("took"), DataValue::from(took)],
+                ];
+                rows.extend(
+                    counters
+                        .into_iter()
+                        .map(|(k, v)| vec![DataValue::from(k), v]),
+                );
+                Ok(NamedRows::new(
+                    vec!["name".to_string(), "value".to_string()],
+                    rows,
+                ))
+            }
             SysOp::Compact => {
                 if read_only {
                     bail!("Cannot compact in read-only mode");
@@ -1188,6 +1383,8 @@ impl<'s, S: Storage<'s>> Db<S> {
                     vec![vec![DataValue::from(OK_STR)]],
                 ))
             }
+            SysOp::StorageStats => self.storage_stats(),
+            SysOp::RelationStats => self.relation_stats(tx),
             SysOp::ListRelations => self.list_relations(tx),
             SysOp::ListFixedRules => {
                 let rules = self.fixed_rules.read().unwrap();
@@ -1371,6 +1568,16 @@ impl<'s, S: Storage<'s>> Db<S> {
                     vec![vec![DataValue::from(OK_STR)]],
                 ))
             }
+            SysOp::SetRetention(name, retention_micros) => {
+                if read_only {
+                    bail!("Cannot set retention in read-only mode");
+                }
+                tx.set_retention(name, *retention_micros)?;
+                Ok(NamedRows::new(
+                    vec![STATUS_STR.to_string()],
+                    vec![vec![DataValue::from(OK_STR)]],
+                ))
+            }
             SysOp::SetAccessLevel(names, level) => {
                 if read_only {
                     bail!("Cannot set access level in read-only mode");
@@ -1627,6 +1834,57 @@ impl<'s, S: Storage<'s>> Db<S> {
             }
         }
     }
+    pub(crate) fn storage_stats(&'s self) -> Result<NamedRows> {
+        let rows = self
+            .db
+            .storage_stats()?
+            .into_iter()
+            .map(|(k, v)| vec![DataValue::from(k), v])
+            .collect_vec();
+        Ok(NamedRows::new(
+            vec!["name".to_string(), "value".to_string()],
+            rows,
+        ))
+    }
+    /// Statistics kept by the storage engine for each stored relation, with nulls for engines
+    /// that keep none.
+    fn relation_stats(&'s self, tx: &SessionTx<'_>) -> Result<NamedRows> {
+        let lower = vec![DataValue::from("")].encode_as_key(RelationId::SYSTEM);
+        let upper =
+            vec![DataValue::from(String::from(LARGEST_UTF_CHAR))].encode_as_key(RelationId::SYSTEM);
+        let mut rows = vec![];
+        for kv_res in tx.store_tx.range_scan(&lower, &upper) {
+            let (k_slice, v_slice) = kv_res?;
+            if upper <= k_slice {
+                break;
+            }
+            let meta = RelationHandle::decode(&v_slice)?;
+            let stats = tx.relation_stats(&meta);
+            let stat = |f: fn(&RelationStats) -> usize| match &stats {
+                Some(s) => DataValue::from(f(s) as i64),
+                None => DataValue::Null,
+            };
+            rows.push(vec![
+                DataValue::from(meta.name.as_str()),
+                stat(|s| s.num_rows),
+                stat(|s| s.distinct_first_keys),
+                stat(|s| s.key_bytes),
+                stat(|s| s.value_bytes),
+                stat(|s| s.num_files),
+            ]);
+        }
+        Ok(NamedRows::new(
+            vec![
+                "name".to_string(),
+                "rows".to_string(),
+                "distinct_first_keys".to_string(),
+                "key_bytes".to_string(),
+                "value_bytes".to_string(),
+                "files".to_string(),
+            ],
+            rows,
+        ))
+    }
     pub(crate) fn list_running(&self) -> Result<NamedRows> {
         let rows = self
             .running_queries
@@ -1772,6 +2030,7 @@ impl<'s, S: Storage<'s>> Db<S> {
             let n_keys = meta.metadata.keys.len();
             let n_dependents = meta.metadata.non_keys.len();
             let arity = n_keys + n_dependents;
+            let estimated_rows = tx.estimated_rows(&meta);
             let name = meta.name;
             let access_level = if name.contains(':') {
                 "index".to_string()
@@ -1788,6 +2047,7 @@ impl<'s, S: Storage<'s>> Db<S> {
                 json!(meta.rm_triggers.len()),
                 json!(meta.replace_triggers.len()),
                 json!(meta.description),
+                json!(estimated_rows),
             ]);
         }
         let rows = rows
@@ -1805,6 +2065,7 @@ impl<'s, S: Storage<'s>> Db<S> {
                 "n_rm_triggers".to_string(),
                 "n_replace_triggers".to_string(),
                 "description".to_string(),
+                "estimated_rows".to_string(),
             ],
             rows,
         ))
@@ -1837,6 +2098,19 @@ pub fn get_variables(src: &str, params: &BTreeMap<String, DataValue>) -> Result<
     })
 }
 
+/// Opens a RocksDB checkpoint as the source of a restore or import. It is opened read-only,
+/// so that it stays as it is and can be open elsewhere at the same time.
+#[cfg(feature = "storage-rocksdb")]
+fn open_checkpoint(path: &Path) -> Result<Db<crate::RocksDbStorage>> {
+    crate::new_cozo_rocksdb_with_options(
+        path,
+        &crate::RocksDbOptions {
+            read_only: true,
+            ..Default::default()
+        },
+    )
+}
+
 fn _evaluate_expressions(
     src: &str,
     params: &BTreeMap<String, DataValue>,
@@ -6,7 +6,7 @@
  * You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
-use std::collections::BTreeMap;
+use std::collections::{BTreeMap, BTreeSet};
 use std::fmt::{Debug, Display, Formatter};
 use std::sync::atomic::Ordering;
 
@@ -20,10 +20,11 @@ use smartstring::{LazyCompact, SmartString};
 use thiserror::Error;
 
 use crate::data::memcmp::MemCmpEncoder;
+use crate::data::program::AccumOp;
 use crate::data::relation::{ColType, ColumnDef, NullableColType, StoredRelationMetadata};
 use crate::data::symb::Symbol;
 use crate::data::tuple::{decode_tuple_from_key, Tuple, TupleT, ENCODED_KEY_MIN_LEN};
-use crate::data::value::{DataValue, ValidityTs};
+use crate::data::value::{DataValue, ValidityTs, LARGEST_UTF_CHAR};
 use crate::fts::FtsIndexManifest;
 use crate::parse::expr::build_expr;
 use crate::parse::sys::{FtsIndexConfig, HnswIndexConfig, MinHashLshConfig};
@@ -32,6 +33,7 @@ use crate::query::compile::IndexPositionUse;
 use crate::runtime::hnsw::HnswIndexManifest;
 use crate::runtime::minhash_lsh::{HashPermutations, LshParams, MinHashLshIndexManifest, Weights};
 use crate::runtime::transact::SessionTx;
+use crate::storage::RelationStats;
 use crate::utils::TempCollector;
 use crate::{NamedRows, StoreTx};
 
@@ -71,6 +73,10 @@ impl RelationId {
     }
 }
 
+/// Relations estimated to have fewer rows than this are scanned rather than looked up through
+/// an index that needs joining back.
+pub(crate) const SMALL_RELATION_ROWS: usize = 256;
+
 #[derive(Clone, PartialEq, serde_derive::Serialize, serde_derive::Deserialize)]
 pub(crate) struct RelationHandle {
     pub(crate) name: SmartString<LazyCompact>,
@@ -90,6 +96,10 @@ pub(crate) struct RelationHandle {
         (RelationHandle, RelationHandle, MinHashLshIndexManifest),
     >,
     pub(crate) description: SmartString<LazyCompact>,
+    /// For relations with time travel, how long superseded versions are kept, in microseconds.
+    /// `None` keeps all versions.
+    #[serde(default)]
+    pub(crate) retention: Option<i64>,
 }
 
 impl RelationHandle {
@@ -193,14 +203,19 @@ impl RelationHandle {
         let prefix_bytes = self.id.0.to_be_bytes();
         data[0..8].copy_from_slice(&prefix_bytes);
     }
+    /// Chooses the index giving the longest bound prefix. An index that has to be joined back to
+    /// the relation costs a second lookup per row, which does not pay off for relations estimated
+    /// to be smaller than `SMALL_RELATION_ROWS`.
     pub(crate) fn choose_index(
         &self,
         arg_uses: &[IndexPositionUse],
         validity_query: bool,
+        estimated_rows: Option<usize>,
     ) -> Option<(RelationHandle, Vec<usize>, bool)> {
         if self.indices.is_empty() {
             return None;
         }
+        let is_small = estimated_rows.map_or(false, |n| n < SMALL_RELATION_ROWS);
         if *arg_uses.first().unwrap() == IndexPositionUse::Join {
             return None;
         }
@@ -231,7 +246,6 @@ impl RelationHandle {
                 }
             }
             if cur_prefix_len > max_prefix_len {
-                max_prefix_len = cur_prefix_len;
                 let mut need_join = false;
                 for need_pos in required_positions.iter() {
                     if !mapper.contains(need_pos) {
@@ -239,6 +253,10 @@ impl RelationHandle {
                         break;
                     }
                 }
+                if need_join && is_small {
+                    continue;
+                }
+                max_prefix_len = cur_prefix_len;
                 chosen = Some((manifest.clone(), mapper.clone(), need_join))
             }
         }
@@ -294,6 +312,20 @@ impl RelationHandle {
         tuple.serialize(&mut Serializer::new(&mut ret)).unwrap();
         Ok(ret)
     }
+    /// Encodes a merge operand of `:accumulate`: the non-key values of a row, and which of them
+    /// are combined with the stored ones using `op`. The others only fill in new rows.
+    pub(crate) fn encode_accum_operand_for_store(
+        &self,
+        op: AccumOp,
+        vals: &[DataValue],
+        accumulated: &[bool],
+    ) -> Vec<u8> {
+        let mut ret = self.encode_key_prefix(vals.len());
+        (op, vals, accumulated)
+            .serialize(&mut Serializer::new(&mut ret))
+            .unwrap();
+        ret
+    }
     pub(crate) fn ensure_compatible(
         &self,
         inp: &InputRelationHandle,
@@ -397,6 +429,30 @@ impl RelationHandle {
         }
     }
 
+    pub(crate) fn multi_get(
+        &self,
+        tx: &SessionTx<'_>,
+        keys: &[&[DataValue]],
+    ) -> Result<Vec<Option<Tuple>>> {
+        let keys_data = keys
+            .iter()
+            .map(|key| key.encode_as_key(self.id))
+            .collect_vec();
+        let found = if self.is_temp {
+            tx.temp_store_tx.multi_get(&keys_data, false)?
+        } else {
+            tx.store_tx.multi_get(&keys_data, false)?
+        };
+        Ok(keys_data
+            .iter()
+            .zip(found)
+            .map(|(key_data, val_data)| {
+                val_data
+                    .map(|val_data| decode_tuple_from_kv(key_data, &val_data, Some(self.arity())))
+            })
+            .collect_vec())
+    }
+
     pub(crate) fn get_val_only(
         &self,
         tx: &SessionTx<'_>,
@@ -425,6 +481,22 @@ impl RelationHandle {
         }
     }
 
+    pub(crate) fn multi_exists(
+        &self,
+        tx: &SessionTx<'_>,
+        keys: &[&[DataValue]],
+    ) -> Result<Vec<bool>> {
+        let keys_data = keys
+            .iter()
+            .map(|key| key.encode_as_key(self.id))
+            .collect_vec();
+        if self.is_temp {
+            tx.temp_store_tx.multi_exists(&keys_data, false)
+        } else {
+            tx.store_tx.multi_exists(&keys_data, false)
+        }
+    }
+
     pub(crate) fn scan_prefix<'a>(
         &self,
         tx: &'a SessionTx<'_>,
@@ -620,6 +692,7 @@ impl<'a> SessionTx<'a> {
             fts_indices: Default::default(),
             lsh_indices: Default::default(),
             description: Default::default(),
+            retention: None,
         };
 
         let name_key = vec![DataValue::Str(meta.name.clone())].encode_as_key(RelationId::SYSTEM);
@@ -634,6 +707,7 @@ impl<'a> SessionTx<'a> {
             self.temp_store_tx.put(&name_key, &meta_val)?;
             self.temp_store_tx.put(&t_encoded, &meta.id.raw_encode())?;
         } else {
+            self.store_tx.relation_created(meta.id.0, &meta.name)?;
             self.store_tx.put(&encoded, &meta.id.raw_encode())?;
             self.store_tx.put(&name_key, &meta_val)?;
             self.store_tx.put(&t_encoded, &meta.id.raw_encode())?;
@@ -662,6 +736,51 @@ impl<'a> SessionTx<'a> {
         let metadata = RelationHandle::decode(&found)?;
         Ok(metadata)
     }
+    /// Estimated number of rows of a stored relation, if the storage engine can tell
+    /// without scanning. Used for planning, so errors are treated as having no estimate.
+    pub(crate) fn estimated_rows(&self, handle: &RelationHandle) -> Option<usize> {
+        if handle.is_temp {
+            return None;
+        }
+        let lower = handle.id.raw_encode();
+        let upper = handle.id.next().raw_encode();
+        self.store_tx
+            .range_count_estimate(&lower, &upper)
+            .ok()
+            .flatten()
+    }
+
+    /// Statistics the storage engine keeps for a stored relation, if any.
+    pub(crate) fn relation_stats(&self, handle: &RelationHandle) -> Option<RelationStats> {
+        if handle.is_temp {
+            return None;
+        }
+        self.store_tx.relation_stats(handle.id.0).ok().flatten()
+    }
+
+    /// Estimated number of rows of a stored relation, and of rows per distinct first key,
+    /// for reordering joins. Computed once per transaction, since asking the storage engine
+    /// is not free and the plan does not need to follow the writes of the transaction.
+    pub(crate) fn planner_estimates(&self, name: &str) -> Option<(usize, usize)> {
+        if let Some(found) = self.planner_estimates.lock().unwrap().get(name) {
+            return *found;
+        }
+        let estimates = self.get_relation(name, false).ok().and_then(|handle| {
+            let rows = self.estimated_rows(&handle)?;
+            let rows_per_key = match self.relation_stats(&handle) {
+                Some(stats) if stats.distinct_first_keys > 0 => {
+                    (stats.num_rows / stats.distinct_first_keys).max(1)
+                }
+                _ => 1,
+            };
+            Some((rows, rows_per_key))
+        });
+        self.planner_estimates
+            .lock()
+            .unwrap()
+            .insert(SmartString::from(name), estimates);
+        estimates
+    }
     pub(crate) fn describe_relation(&mut self, name: &str, description: &str) -> Result<()> {
         let mut meta = self.get_relation(name, true)?;
 
@@ -736,6 +855,71 @@ impl<'a> SessionTx<'a> {
         Ok(())
     }
 
+    pub(crate) fn set_retention(
+        &mut self,
+        rel: &Symbol,
+        retention_micros: Option<i64>,
+    ) -> Result<()> {
+        let mut meta = self.get_relation(rel, true)?;
+        if meta.is_temp {
+            bail!("Cannot set retention on temp relation '{}'", meta.name);
+        }
+        match meta.metadata.keys.last() {
+            Some(col) if col.typing.coltype == ColType::Validity => {}
+            _ => bail!(
+                "Cannot set retention on relation '{}': its last key column is not a validity",
+                meta.name
+            ),
+        }
+        meta.retention = retention_micros;
+
+        let name_key = vec![DataValue::Str(meta.name.clone())].encode_as_key(RelationId::SYSTEM);
+
+        let mut meta_val = vec![];
+        meta.serialize(&mut Serializer::new(&mut meta_val).with_struct_map())
+            .unwrap();
+        self.store_tx.put(&name_key, &meta_val)?;
+        self.store_tx
+            .set_relation_retention(meta.id.0, retention_micros)?;
+
+        Ok(())
+    }
+
+    /// Hands the retention of every stored relation and the ids of all relations and indices
+    /// to the storage engine, when opening the database.
+    pub(crate) fn load_relation_settings(&mut self) -> Result<()> {
+        let lower = vec![DataValue::from("")].encode_as_key(RelationId::SYSTEM);
+        let upper =
+            vec![DataValue::from(String::from(LARGEST_UTF_CHAR))].encode_as_key(RelationId::SYSTEM);
+        let mut found = vec![];
+        let mut ids = BTreeSet::new();
+        for kv_res in self.store_tx.range_scan(&lower, &upper) {
+            let (k_slice, v_slice) = kv_res?;
+            if upper <= k_slice {
+                break;
+            }
+            let meta = RelationHandle::decode(&v_slice)?;
+            if let Some(retention_micros) = meta.retention {
+                found.push((meta.id.0, retention_micros));
+            }
+            ids.insert(meta.id.0);
+            ids.extend(meta.indices.values().map(|(h, _)| h.id.0));
+            ids.extend(meta.hnsw_indices.values().map(|(h, _)| h.id.0));
+            ids.extend(meta.fts_indices.values().map(|(h, _)| h.id.0));
+            ids.extend(
+                meta.lsh_indices
+                    .values()
+                    .flat_map(|(h, inv, _)| [h.id.0, inv.id.0]),
+            );
+        }
+        for (id, retention_micros) in found {
+            self.store_tx
+                .set_relation_retention(id, Some(retention_micros))?;
+        }
+        self.store_tx.relations_loaded(&ids)?;
+        Ok(())
+    }
+
     pub(crate) fn create_minhash_lsh_index(&mut self, config: &MinHashLshConfig) -> Result<()> {
         // Get relation handle
         let mut rel_handle = self.get_relation(&config.base_relation, true)?;
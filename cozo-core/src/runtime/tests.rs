@@ -1225,4 +1225,1021 @@ fn update_shall_work() {
     db.run_default(r"?[x, y] <- [[1, 4]] :update z {x, y}").unwrap();
     let r = db.run_default(r"?[x, y, z] := *z {x, y, z}").unwrap();
     assert_eq!(r.into_json()["rows"], json!([[1, 4, 3]]));
-}
\ No newline at end of file
+}
+
+#[test]
+fn point_lookup_join_in_batches() {
+    let db = DbInstance::default();
+    db.run_default(r"?[x, y] := x in int_range(600), y = x * 2 :create r {x => y}")
+        .unwrap();
+    let r = db
+        .run_default(r"?[count(x), sum(y)] := x in int_range(1000), *r{x, y}")
+        .unwrap();
+    assert_eq!(r.into_json()["rows"], json!([[600, 359400.0]]));
+    let r = db
+        .run_default(r"?[count(x)] := x in int_range(1000), *r{x}")
+        .unwrap();
+    assert_eq!(r.into_json()["rows"], json!([[600]]));
+}
+
+#[test]
+fn storage_stats_op() {
+    let db = DbInstance::default();
+    let r = db.run_default(r"::storage_stats").unwrap();
+    let r = r.into_json();
+    assert_eq!(r["headers"], json!(["name", "value"]));
+    assert_eq!(r["rows"], json!([]));
+}
+
+#[test]
+fn analyze_op() {
+    let db = DbInstance::default();
+    let r = db
+        .run_default(r"::analyze { ?[x] <- [[1], [2]] }")
+        .unwrap()
+        .into_json();
+    assert_eq!(r["headers"], json!(["name", "value"]));
+    assert_eq!(r["rows"][0], json!(["rows", 2]));
+    assert!(db
+        .run_default(r"::analyze { ?[x] <- [[1]] :create a {x} }")
+        .is_err());
+}
+
+#[test]
+fn retention_op() {
+    let db = DbInstance::default();
+    db.run_default(":create hist {k: Int, vld: Validity => v}")
+        .unwrap();
+    db.run_default(":create plain {k: Int => v}").unwrap();
+    db.run_default("::retention hist 86400").unwrap();
+    db.run_default("::retention hist null").unwrap();
+    assert!(db.run_default("::retention plain 86400").is_err());
+    assert!(db.run_default("::retention hist -1").is_err());
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn retention_gc_rocksdb() {
+    let (db, path) = temp_rocksdb("retention_gc");
+    db.run_default(":create hist {k: Int, vld: Validity => v}")
+        .unwrap();
+    // With a retention of one day, the versions of 1970 are older than the horizon
+    // and those of 2100 newer
+    db.run_default(
+        r"?[k, vld, v] <- [
+            [1, [1000000, true], 'v1'],
+            [1, [2000000, true], 'v2'],
+            [1, [3000000, true], 'v3'],
+            [1, [4102444800000000, true], 'v4'],
+            [1, [4102444900000000, true], 'v5'],
+            [2, [1000000, true], 'w1'],
+            [2, [2000000, false], 'w2'],
+            [3, [1000000, true], 'x1']
+        ] :put hist {k, vld => v}",
+    )
+    .unwrap();
+    let as_of = |at: &str| {
+        db.run_default(&format!("?[k, v] := *hist{{k, v @ {at}}}"))
+            .unwrap()
+            .into_json()["rows"]
+            .clone()
+    };
+    let points = [
+        "3000000",
+        "'NOW'",
+        "4102444800000000",
+        "4102444850000000",
+        "'END'",
+    ];
+    let before = points.iter().map(|at| as_of(at)).collect_vec();
+
+    db.run_default("::retention hist 86400").unwrap();
+    db.run_default("::compact").unwrap();
+
+    let after = points.iter().map(|at| as_of(at)).collect_vec();
+    assert_eq!(before, after);
+    let res = db
+        .run_default("?[k, v] := *hist{k, v}")
+        .unwrap()
+        .into_json();
+    assert_eq!(
+        res["rows"],
+        json!([[1, "v3"], [1, "v4"], [1, "v5"], [2, "w2"], [3, "x1"]])
+    );
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+fn accumulate_mutation() {
+    let db = DbInstance::default();
+    db.run_default(
+        ":create counters {k: String => hits: Int, seen: Int default 0, tag: String default 'x'}",
+    )
+    .unwrap();
+    db.run_default(r"?[k, hits, seen] <- [['a', 1, 5], ['b', 2, 3], ['a', 4, 1]] :accumulate sum counters {k, hits, seen}")
+        .unwrap();
+    db.run_default(r"?[k, seen] <- [['a', 2], ['b', 10]] :accumulate max counters {k, seen}")
+        .unwrap();
+    db.run_default(r"?[k, hits] <- [['a', 0], ['c', 0]] :accumulate count counters {k, hits}")
+        .unwrap();
+    let res = db
+        .run_default("?[k, hits, seen, tag] := *counters{k, hits, seen, tag}")
+        .unwrap()
+        .into_json();
+    assert_eq!(
+        res["rows"],
+        json!([["a", 6, 6, "x"], ["b", 2, 10, "x"], ["c", 1, 0, "x"]])
+    );
+    assert!(db
+        .run_default(r"?[k, hits] <- [['a', 'x']] :accumulate sum counters {k, hits}")
+        .is_err());
+    db.run_default(
+        r"?[k, hits] <- [['b', 9223372036854775807]] :accumulate sum counters {k, hits}",
+    )
+    .unwrap();
+    let res = db
+        .run_default("?[hits] := *counters{k: 'b', hits}")
+        .unwrap()
+        .into_json();
+    assert_eq!(res["rows"], json!([[i64::MAX]]));
+}
+
+#[test]
+fn estimated_rows_in_relations() {
+    let db = DbInstance::default();
+    db.run_default(r"?[a, b] <- [[1, 2], [2, 3]] :create e {a => b}")
+        .unwrap();
+    db.run_default(r"?[b, c] <- [[2, 'x'], [3, 'y']] :create f {b => c}")
+        .unwrap();
+    let rels = db.run_default("::relations").unwrap();
+    assert_eq!(rels.headers.last().unwrap(), "estimated_rows");
+    let res = db
+        .run_default("?[a, c] := *f{b, c}, *e{a, b}")
+        .unwrap()
+        .into_json();
+    assert_eq!(res["rows"], json!([[1, "x"], [2, "y"]]));
+}
+
+#[test]
+fn relation_stats_op() {
+    let db = DbInstance::default();
+    db.run_default(r"?[a, b] <- [[1, 2], [2, 3]] :create e {a => b}")
+        .unwrap();
+    let res = db.run_default("::relation_stats").unwrap().into_json();
+    assert_eq!(res["rows"], json!([["e", null, null, null, null, null]]));
+}
+
+/// A fresh RocksDB database in the temporary directory, removing what an earlier run left there.
+#[cfg(feature = "storage-rocksdb")]
+fn temp_rocksdb(name: &str) -> (DbInstance, std::path::PathBuf) {
+    temp_rocksdb_with_options(name, "")
+}
+
+/// Same as [temp_rocksdb], with options given as JSON.
+#[cfg(feature = "storage-rocksdb")]
+fn temp_rocksdb_with_options(name: &str, options: &str) -> (DbInstance, std::path::PathBuf) {
+    let path = std::env::temp_dir().join(format!("_cozo_test_{name}"));
+    let _ = std::fs::remove_dir_all(&path);
+    let db = DbInstance::new("rocksdb", &path, options).unwrap();
+    (db, path)
+}
+
+/// The value `::storage_stats` reports under `name`.
+#[cfg(feature = "storage-rocksdb")]
+fn storage_stat(db: &DbInstance, name: &str) -> u64 {
+    let r = db.run_default("::storage_stats").unwrap().into_json();
+    r["rows"]
+        .as_array()
+        .unwrap()
+        .iter()
+        .find(|row| row[0] == name)
+        .unwrap_or_else(|| panic!("no storage stat {name}"))[1]
+        .as_u64()
+        .unwrap()
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn storage_stats_rocksdb() {
+    let options =
+        r#"{"block_cache_size": 8388608, "row_cache_size": 4194304, "enable_statistics": true}"#;
+    let (db, path) = temp_rocksdb_with_options("storage_stats", options);
+    assert_eq!(storage_stat(&db, "block_cache_capacity"), 8 << 20);
+    assert_eq!(storage_stat(&db, "row_cache_capacity"), 4 << 20);
+    db.run_default("?[k, v] := k in int_range(10000), v = k * 2 :create r {k => v}")
+        .unwrap();
+    db.run_default("::compact").unwrap();
+    let r = db.run_default("?[sum(v)] := *r{v}").unwrap().into_json();
+    assert_eq!(r["rows"], json!([[99990000.0]]));
+    let r = db
+        .run_default("?[v] := *r{k: 5000, v}")
+        .unwrap()
+        .into_json();
+    assert_eq!(r["rows"], json!([[10000]]));
+    // The scan after compaction reads its blocks from the new files through the block cache
+    let block_usage = storage_stat(&db, "block_cache_usage");
+    assert!(block_usage > 0 && block_usage <= 8 << 20);
+    assert!(storage_stat(&db, "row_cache_usage") <= 4 << 20);
+    assert!(storage_stat(&db, "block_cache_miss") > 0);
+    drop(db);
+
+    // Without statistics, the counters are left out
+    let db = DbInstance::new("rocksdb", &path, r#"{"block_cache_size": 8388608}"#).unwrap();
+    assert_eq!(storage_stat(&db, "block_cache_capacity"), 8 << 20);
+    assert_eq!(storage_stat(&db, "row_cache_capacity"), 0);
+    let r = db.run_default("::storage_stats").unwrap().into_json();
+    assert!(r["rows"]
+        .as_array()
+        .unwrap()
+        .iter()
+        .all(|row| row[0] != "block_cache_hit"));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn relation_stats_rocksdb() {
+    let (db, path) = temp_rocksdb("relation_stats");
+    db.run_default(":create mixed {a: Any, b: Int => v}")
+        .unwrap();
+    // The first key column takes every kind of value whose encoded length the statistics
+    // collector works out: strings and lists spanning several groups of 8 bytes, and
+    // integers too large for a float, which carry an extra exact copy
+    db.run_default(
+        r"?[a, b, v] <- [
+            ['a string longer than eight bytes', 1, 0],
+            ['a string longer than eight bytes', 2, 0],
+            [9007199254740993, 1, 0],
+            [9007199254740993, 2, 0],
+            [[1, 'another long string in a list'], 1, 0],
+            [[1, 'another long string in a list'], 2, 0],
+            [1.5, 1, 0]
+        ] :put mixed {a, b => v}",
+    )
+    .unwrap();
+    db.run_default("::compact").unwrap();
+    let res = db.run_default("::relation_stats").unwrap().into_json();
+    let row = &res["rows"][0];
+    assert_eq!(row[0], json!("mixed"));
+    assert_eq!(row[1], json!(7));
+    assert_eq!(row[2], json!(4));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn point_lookup_join_rocksdb() {
+    let (db, path) = temp_rocksdb("point_lookup_join");
+    db.run_default(r"?[x, y] := x in int_range(600), y = x * 2 :create r {x => y}")
+        .unwrap();
+    // Lookups binding only the keys check for existence without fetching the values
+    let r = db
+        .run_default(r"?[count(x)] := x in int_range(1000), *r{x}")
+        .unwrap();
+    assert_eq!(r.into_json()["rows"], json!([[600]]));
+    let r = db
+        .run_default(r"?[count(x), sum(y)] := x in int_range(1000), *r{x, y}, y % 4 == 0")
+        .unwrap();
+    assert_eq!(r.into_json()["rows"], json!([[300, 179400.0]]));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn wide_row_scan_rocksdb() {
+    let (db, path) = temp_rocksdb("wide_row_scan");
+    // Rows of 64 KiB each, so that every batch fetched from the iterator is megabytes large
+    let pad = "x".repeat(1 << 16);
+    db.run_script(
+        r"?[k, v] := k in int_range(200), v = concat(to_string(k), $pad) :create wide {k => v}",
+        BTreeMap::from([("pad".into(), DataValue::from(pad.as_str()))]),
+        ScriptMutability::Mutable,
+    )
+    .unwrap();
+    db.run_default("::compact").unwrap();
+    let r = db
+        .run_default(r"?[count(k), sum(l)] := *wide{k, v}, l = length(v)")
+        .unwrap();
+    let expected_len: usize = (0..200).map(|k: i64| k.to_string().len() + (1 << 16)).sum();
+    assert_eq!(r.into_json()["rows"], json!([[200, expected_len as f64]]));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn changes_since_rocksdb() {
+    let (db, path) = temp_rocksdb("changes_since");
+    db.run_default("?[a] <- [[1], [2]] :create r {a}").unwrap();
+    let puts = |seq| {
+        db.changes_since(seq, 100)
+            .unwrap()
+            .into_iter()
+            .filter(|ev| ev.relation.as_deref() == Some("r"))
+            .collect_vec()
+    };
+    let changes = puts(0);
+    assert_eq!(
+        changes.iter().map(|ev| ev.tuple.clone()).collect_vec(),
+        vec![vec![DataValue::from(1)], vec![DataValue::from(2)]]
+    );
+    let resume_from = changes.last().unwrap().seq + 1;
+
+    // Rolled-back writes never reach the log
+    let tx = db.multi_transaction(true);
+    tx.run_script("?[a] <- [[3]] :put r {a}", Default::default())
+        .unwrap();
+    tx.abort().unwrap();
+    db.run_default("?[a] <- [[4]] :put r {a}").unwrap();
+    let changes = puts(resume_from);
+    assert_eq!(changes.len(), 1);
+    assert!(matches!(changes[0].op, crate::ChangeOp::Put));
+    assert_eq!(changes[0].tuple, vec![DataValue::from(4)]);
+    assert!(puts(changes[0].seq + 1).is_empty());
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+
+    let (db, path) = temp_rocksdb_with_options(
+        "changes_since_unprepared",
+        r#"{"write_policy": "unprepared"}"#,
+    );
+    db.run_default("?[a] <- [[1]] :create r {a}").unwrap();
+    assert!(db.changes_since(0, 100).is_err());
+    drop(db);
+    let _ = std::fs::remove_dir_all(&path);
+    assert!(DbInstance::new(
+        "rocksdb",
+        &path,
+        r#"{"write_policy": "prepared", "wal_ttl_seconds": 3600}"#
+    )
+    .is_err());
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn pooled_iterators_rocksdb() {
+    let (db, path) = temp_rocksdb("pooled_iterators");
+    db.run_default("?[k, j] <- [[1, 1], [1, 2], [2, 1], [3, 1]] :create a {k, j}")
+        .unwrap();
+    db.run_default("?[k, l] <- [[1, 10], [2, 20], [3, 30]] :create b {k, l}")
+        .unwrap();
+    let tx = db.multi_transaction(true);
+    // Prefix scans of the two relations alternate, each reusing the iterator of its relation.
+    // The empty prefix of 0 must not run on into the rows of 1.
+    let r = tx
+        .run_script(
+            "?[k, j, l] := k in [0, 1, 2, 3], *a{k, j}, *b{k, l}",
+            Default::default(),
+        )
+        .unwrap();
+    assert_eq!(
+        r.into_json()["rows"],
+        json!([[1, 1, 10], [1, 2, 10], [2, 1, 20], [3, 1, 30]])
+    );
+    // Iterators created before a write of the transaction must not be reused after it
+    tx.run_script("?[k, j] <- [[2, 5]] :put a {k, j}", Default::default())
+        .unwrap();
+    let r = tx
+        .run_script("?[k, j] := k in [0, 2], *a{k, j}", Default::default())
+        .unwrap();
+    assert_eq!(r.into_json()["rows"], json!([[2, 1], [2, 5]]));
+    tx.abort().unwrap();
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn reorder_relations_rocksdb() {
+    let (db, path) = temp_rocksdb("reorder_relations");
+    db.run_default(r"?[a, b] := a in int_range(5000), b = a % 7 :create big {a => b}")
+        .unwrap();
+    db.run_default(r"?[b, c] <- [[1, 'x'], [2, 'y']] :create small {b => c}")
+        .unwrap();
+    db.run_default("::compact").unwrap();
+    let loaded = |query: &str| {
+        db.run_default(&format!("::explain {{ {query} }}"))
+            .unwrap()
+            .into_json()["rows"]
+            .as_array()
+            .unwrap()
+            .iter()
+            .filter_map(|row| row[5].as_str().map(|s| s.to_string()))
+            .collect_vec()
+    };
+    let as_written = loaded("?[a, c] := *big{a, b}, *small{b, c}");
+    let small_first = loaded("?[a, c] := *small{b, c}, *big{a, b}");
+    assert_ne!(as_written, small_first);
+    // The smaller relation is only moved first when asked for
+    let reordered = loaded("?[a, c] := *big{a, b}, *small{b, c} :reorder_relations true");
+    assert_eq!(reordered, small_first);
+    let res = db
+        .run_default("?[count(a)] := *big{a, b}, *small{b, c} :reorder_relations true")
+        .unwrap()
+        .into_json();
+    assert_eq!(res["rows"], json!([[1429]]));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn relation_column_families_rocksdb() {
+    let options = r#"{"relation_column_families": true}"#;
+    let (db, path) = temp_rocksdb_with_options("relation_cfs", options);
+    let cf_ids = |db: &DbInstance| match db {
+        DbInstance::RocksDb(db) => db.storage().relation_cf_ids(),
+        _ => unreachable!(),
+    };
+    db.run_default("?[k, v] <- [[1, 'a'], [2, 'b']] :create a {k => v}")
+        .unwrap();
+    assert_eq!(cf_ids(&db).len(), 1);
+    // A creation that is rolled back leaves no column family behind
+    let tx = db.multi_transaction(true);
+    tx.run_script("?[k] <- [[1]] :create b {k}", Default::default())
+        .unwrap();
+    assert_eq!(cf_ids(&db).len(), 2);
+    tx.abort().unwrap();
+    assert_eq!(cf_ids(&db).len(), 1);
+    db.run_default("::remove a").unwrap();
+    assert!(cf_ids(&db).is_empty());
+    db.run_default("?[k, v] <- [[3, 'c']] :create c {k => v}")
+        .unwrap();
+    drop(db);
+
+    let db = DbInstance::new("rocksdb", &path, options).unwrap();
+    assert_eq!(cf_ids(&db).len(), 1);
+    let res = db.run_default("?[k, v] := *c{k, v}").unwrap().into_json();
+    assert_eq!(res["rows"], json!([[3, "c"]]));
+    assert!(db.run_default("?[k] := *a{k}").is_err());
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn removal_compactions_rocksdb() {
+    let options = r#"{"removal_compaction_delay_ms": 50}"#;
+    let (db, path) = temp_rocksdb_with_options("removal_compactions", options);
+    let stat = |db: &DbInstance, name: &str| {
+        let r = db.run_default("::storage_stats").unwrap().into_json();
+        r["rows"]
+            .as_array()
+            .unwrap()
+            .iter()
+            .find(|row| row[0] == name)
+            .unwrap()[1]
+            .as_u64()
+            .unwrap()
+    };
+    for name in ["a", "b", "c", "d"] {
+        db.run_default(&format!(
+            "?[k, v] := k in int_range(1000), v = k * 2 :create {name} {{k => v}}"
+        ))
+        .unwrap();
+    }
+    db.run_default("::compact").unwrap();
+    assert_eq!(stat(&db, "range_tombstones"), 0);
+    // Relations created one after another are adjacent, so their ranges are compacted together
+    db.run_default("::remove a, b, c").unwrap();
+    let deadline = std::time::Instant::now() + std::time::Duration::from_secs(10);
+    while stat(&db, "removal_compactions_pending") > 0 {
+        assert!(std::time::Instant::now() < deadline);
+        std::thread::sleep(std::time::Duration::from_millis(10));
+    }
+    assert_eq!(stat(&db, "range_tombstones"), 0);
+    let r = db.run_default("?[count(k)] := *d{k}").unwrap().into_json();
+    assert_eq!(r["rows"], json!([[1000]]));
+    drop(db);
+
+    // The count is loaded from the table properties on open
+    let db = DbInstance::new("rocksdb", &path, options).unwrap();
+    assert_eq!(stat(&db, "range_tombstones"), 0);
+    assert_eq!(stat(&db, "removal_compactions_pending"), 0);
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+/// A key under a relation id no relation gets, for tests writing to the store directly.
+#[cfg(feature = "storage-rocksdb")]
+fn scratch_key(suffix: &[u8]) -> Vec<u8> {
+    [(1u64 << 48).to_be_bytes().as_slice(), suffix].concat()
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn optimistic_transactions_rocksdb() {
+    use crate::storage::{Storage, StoreTx, TransactionConflict};
+
+    let (db, path) =
+        temp_rocksdb_with_options("optimistic", r#"{"optimistic_transactions": true}"#);
+    let storage = match &db {
+        DbInstance::RocksDb(db) => db.storage(),
+        _ => unreachable!(),
+    };
+    let key = scratch_key(b"k");
+    let mut tx1 = storage.transact(true).unwrap();
+    let mut tx2 = storage.transact(true).unwrap();
+    tx1.put(&key, b"1").unwrap();
+    // Neither write waits for the other, as no locks are taken
+    tx2.put(&key, b"2").unwrap();
+    tx1.commit().unwrap();
+    let err = tx2.commit().unwrap_err();
+    assert!(err.downcast_ref::<TransactionConflict>().is_some());
+    drop(tx2);
+    let tx = storage.transact(false).unwrap();
+    assert_eq!(
+        tx.get(&key, false).unwrap().as_deref(),
+        Some(b"1".as_slice())
+    );
+    drop(tx);
+    // A retry after the conflict goes through
+    let mut tx2 = storage.transact(true).unwrap();
+    tx2.put(&key, b"2").unwrap();
+    tx2.commit().unwrap();
+    drop(tx2);
+
+    // Scripts run as usual, and the commit of a multi-transaction reports its outcome
+    db.run_default("?[k, v] <- [[1, 'a']] :create r {k => v}")
+        .unwrap();
+    let tx = db.multi_transaction(true);
+    tx.run_script("?[k, v] <- [[2, 'b']] :put r {k => v}", Default::default())
+        .unwrap();
+    tx.commit().unwrap();
+    let r = db.run_default("?[k, v] := *r{k, v}").unwrap().into_json();
+    assert_eq!(r["rows"], json!([[1, "a"], [2, "b"]]));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn read_transaction_snapshot_rocksdb() {
+    use crate::storage::{Storage, StoreTx};
+
+    let (db, path) = temp_rocksdb("read_snapshot");
+    let storage = match &db {
+        DbInstance::RocksDb(db) => db.storage(),
+        _ => unreachable!(),
+    };
+    let keys = (0u8..4).map(|i| scratch_key(&[i])).collect_vec();
+    let mut tx = storage.transact(true).unwrap();
+    for key in &keys[..2] {
+        tx.put(key, b"old").unwrap();
+    }
+    tx.commit().unwrap();
+    drop(tx);
+
+    let mut reader = storage.transact(false).unwrap();
+    let mut tx = storage.transact(true).unwrap();
+    tx.put(&keys[0], b"new").unwrap();
+    tx.del(&keys[1]).unwrap();
+    tx.put(&keys[2], b"new").unwrap();
+    tx.commit().unwrap();
+    drop(tx);
+
+    // The reader sees the store as it was when it started, through every kind of read
+    assert_eq!(
+        reader.get(&keys[0], false).unwrap().as_deref(),
+        Some(b"old".as_slice())
+    );
+    assert_eq!(
+        reader.multi_exists(&keys, false).unwrap(),
+        vec![true, true, false, false]
+    );
+    let scanned = reader
+        .range_scan(&keys[0], &keys[3])
+        .map(|kv| kv.unwrap().0)
+        .collect_vec();
+    assert_eq!(scanned, keys[..2]);
+    assert!(reader.put(&keys[3], b"new").is_err());
+    assert!(reader.del(&keys[0]).is_err());
+    reader.commit().unwrap();
+    drop(reader);
+
+    let reader = storage.transact(false).unwrap();
+    assert_eq!(
+        reader.multi_exists(&keys, false).unwrap(),
+        vec![true, false, true, false]
+    );
+    drop(reader);
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn bulk_load_rocksdb() {
+    let (db, path) = temp_rocksdb("bulk_load_source");
+    db.run_default("?[k, v] := k in int_range(5000), v = to_string(k) :create r {k => v}")
+        .unwrap();
+    let checkpoint = std::env::temp_dir().join("_cozo_test_bulk_load_checkpoint");
+    let _ = std::fs::remove_dir_all(&checkpoint);
+    db.checkpoint_db(&checkpoint).unwrap();
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+
+    // Batches far smaller than the data, so that the load writes out many of them
+    for options in [
+        r#"{"bulk_load_batch_size": 4096}"#,
+        r#"{"bulk_load_batch_size": 4096, "bulk_load_disable_wal": true}"#,
+    ] {
+        let (db, path) = temp_rocksdb_with_options("bulk_load", options);
+        db.restore_backup(&checkpoint).unwrap();
+        let count = |db: &DbInstance| {
+            db.run_default("?[count(k)] := *r{k, v}, v == to_string(k)")
+                .unwrap()
+                .into_json()["rows"]
+                .clone()
+        };
+        assert_eq!(count(&db), json!([[5000]]));
+        drop(db);
+        // Rows written without the write-ahead log were flushed at the end of the load
+        let db = DbInstance::new("rocksdb", &path, options).unwrap();
+        assert_eq!(count(&db), json!([[5000]]));
+        drop(db);
+        let _ = std::fs::remove_dir_all(path);
+    }
+    let _ = std::fs::remove_dir_all(checkpoint);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn lock_contention_rocksdb() {
+    use crate::storage::{Deadlock, LockTimeout, Storage, StoreTx};
+
+    let (db, path) = temp_rocksdb_with_options("lock_timeout", r#"{"lock_timeout_ms": 50}"#);
+    let storage = match &db {
+        DbInstance::RocksDb(db) => db.storage(),
+        _ => unreachable!(),
+    };
+    let key = scratch_key(b"k");
+    let mut tx1 = storage.transact(true).unwrap();
+    let mut tx2 = storage.transact(true).unwrap();
+    tx1.put(&key, b"1").unwrap();
+    let err = tx2.put(&key, b"2").unwrap_err();
+    assert!(err.downcast_ref::<LockTimeout>().is_some());
+    tx1.commit().unwrap();
+    // The lock is released on commit, so the retry goes through
+    tx2.put(&key, b"2").unwrap();
+    tx2.commit().unwrap();
+    drop((tx1, tx2));
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+
+    let options = r#"{"deadlock_detect": true, "lock_timeout_ms": 10000}"#;
+    let (db, path) = temp_rocksdb_with_options("deadlock", options);
+    let storage = match &db {
+        DbInstance::RocksDb(db) => db.storage(),
+        _ => unreachable!(),
+    };
+    let (a, b) = (scratch_key(b"a"), scratch_key(b"b"));
+    let barrier = std::sync::Barrier::new(2);
+    // Each transaction locks one key, then waits for the key the other holds
+    let errors = std::thread::scope(|s| {
+        [(&a, &b), (&b, &a)]
+            .map(|(first, second)| {
+                let barrier = &barrier;
+                s.spawn(move || {
+                    let mut tx = storage.transact(true).unwrap();
+                    tx.put(first, b"x").unwrap();
+                    barrier.wait();
+                    // The aborted transaction is dropped on error, releasing its lock
+                    tx.put(second, b"x").and_then(|_| tx.commit()).err()
+                })
+            })
+            .map(|handle| handle.join().unwrap())
+    });
+    let errors = errors.into_iter().flatten().collect_vec();
+    assert_eq!(errors.len(), 1);
+    assert!(errors[0].downcast_ref::<Deadlock>().is_some());
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn concurrent_writes_rocksdb() {
+    use crate::storage::{Storage, StoreTx};
+
+    // Small memtables in the first case, so that writes go on while full ones are flushed
+    for (name, options) in [
+        (
+            "pipelined_write",
+            r#"{"enable_pipelined_write": true, "write_buffer_size": 65536,
+                "max_write_buffer_number": 4, "write_buffer_memory_budget": 1048576}"#,
+        ),
+        (
+            "unordered_write",
+            r#"{"write_policy": "prepared", "unordered_write": true}"#,
+        ),
+    ] {
+        let (db, path) = temp_rocksdb_with_options(name, options);
+        let storage = match &db {
+            DbInstance::RocksDb(db) => db.storage(),
+            _ => unreachable!(),
+        };
+        let mut tx = storage.transact(true).unwrap();
+        std::thread::scope(|s| {
+            for writer in 0u8..4 {
+                let tx = &tx;
+                s.spawn(move || {
+                    for i in 0u32..2000 {
+                        let key = scratch_key(&[&[writer], i.to_be_bytes().as_slice()].concat());
+                        tx.par_put(&key, &[0xAB; 100]).unwrap();
+                    }
+                });
+            }
+        });
+        tx.commit().unwrap();
+        drop(tx);
+        db.run_default("?[k] <- [[1]] :create r {k}").unwrap();
+        drop(db);
+
+        let db = DbInstance::new("rocksdb", &path, options).unwrap();
+        let storage = match &db {
+            DbInstance::RocksDb(db) => db.storage(),
+            _ => unreachable!(),
+        };
+        let tx = storage.transact(false).unwrap();
+        let count = tx
+            .range_count(&scratch_key(&[]), &scratch_key(&[0xFF]))
+            .unwrap();
+        assert_eq!(count, 8000);
+        drop(tx);
+        let r = db.run_default("?[k] := *r{k}").unwrap().into_json();
+        assert_eq!(r["rows"], json!([[1]]));
+        drop(db);
+        let _ = std::fs::remove_dir_all(path);
+    }
+
+    // Unordered writes keep transactions consistent only under the `prepared` write policy,
+    // and without pipelined writes
+    for options in [
+        r#"{"unordered_write": true}"#,
+        r#"{"write_policy": "prepared", "unordered_write": true, "enable_pipelined_write": true}"#,
+    ] {
+        let path = std::env::temp_dir().join("_cozo_test_unordered_write_rejected");
+        let _ = std::fs::remove_dir_all(&path);
+        assert!(DbInstance::new("rocksdb", &path, options).is_err());
+        let _ = std::fs::remove_dir_all(path);
+    }
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn partitioned_ribbon_filters_rocksdb() {
+    use crate::storage::{Storage, StoreTx};
+
+    let options = r#"{"partitioned_index_filters": true, "ribbon_filter": true,
+        "optimize_filters_for_memory": true, "block_cache_size": 8388608,
+        "enable_statistics": true}"#;
+    let (db, path) = temp_rocksdb_with_options("partitioned_filters", options);
+    let storage = match &db {
+        DbInstance::RocksDb(db) => db.storage(),
+        _ => unreachable!(),
+    };
+    let key = |i: u32| scratch_key(&i.to_be_bytes());
+    let mut tx = storage.transact(true).unwrap();
+    for i in (0..20000).step_by(2) {
+        tx.put(&key(i), &i.to_be_bytes()).unwrap();
+    }
+    tx.commit().unwrap();
+    drop(tx);
+    db.run_default("::compact").unwrap();
+
+    // Keys between those present fall within the range of the files, so only the filters,
+    // read in partitions through the block cache, tell that they are absent
+    let tx = storage.transact(false).unwrap();
+    for i in 0..2000 {
+        let found = tx.get(&key(i), false).unwrap();
+        if i % 2 == 0 {
+            assert_eq!(found.as_deref(), Some(i.to_be_bytes().as_slice()));
+        } else {
+            assert_eq!(found, None);
+        }
+    }
+    drop(tx);
+    let filter_reads =
+        storage_stat(&db, "block_cache_filter_hit") + storage_stat(&db, "block_cache_filter_miss");
+    let index_reads =
+        storage_stat(&db, "block_cache_index_hit") + storage_stat(&db, "block_cache_index_miss");
+    assert!(filter_reads > 0);
+    assert!(index_reads > 0);
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn sst_partitioning_rocksdb() {
+    use crate::storage::{Storage, StoreTx};
+
+    // Without partitioning, the compacted rows of both relations share a file, which the
+    // removal of one of them must leave in place
+    for (prefix_len, files_left) in [(8, 0), (0, 1)] {
+        let options = format!(
+            r#"{{"sst_partition_prefix_len": {prefix_len}, "removal_compaction_delay_ms": 0}}"#
+        );
+        let (db, path) = temp_rocksdb_with_options("sst_partitioning", &options);
+        let inner = match &db {
+            DbInstance::RocksDb(db) => db,
+            _ => unreachable!(),
+        };
+        for name in ["a", "b"] {
+            db.run_default(&format!(
+                "?[k, v] := k in int_range(1000), v = k :create {name} {{k => v}}"
+            ))
+            .unwrap();
+        }
+        db.run_default("::compact").unwrap();
+        let id_of = |name: &str| {
+            inner
+                .transact()
+                .unwrap()
+                .get_relation(name, false)
+                .unwrap()
+                .id
+                .0
+        };
+        let (a, b) = (id_of("a"), id_of("b"));
+        let num_files = |id: u64| {
+            let tx = inner.storage().transact(false).unwrap();
+            tx.relation_stats(id).unwrap().unwrap().num_files
+        };
+        assert_eq!(num_files(a), 1);
+        assert_eq!(num_files(b), 1);
+
+        // With every file within the range of one relation, the files of the removed relation
+        // are deleted whole
+        db.run_default("::remove a").unwrap();
+        assert_eq!(num_files(a), files_left);
+        assert_eq!(num_files(b), 1);
+        let r = db.run_default("?[count(k)] := *b{k}").unwrap().into_json();
+        assert_eq!(r["rows"], json!([[1000]]));
+        drop(db);
+        let _ = std::fs::remove_dir_all(path);
+    }
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn startup_options_rocksdb() {
+    // Files are cut between relations, so that the reopened database has several to open
+    let (db, path) = temp_rocksdb_with_options("startup", r#"{"sst_partition_prefix_len": 8}"#);
+    for name in ["a", "b", "c", "d"] {
+        db.run_default(&format!(
+            "?[k, v] := k in int_range(500), v = k :create {name} {{k => v}}"
+        ))
+        .unwrap();
+    }
+    db.run_default("::compact").unwrap();
+    drop(db);
+
+    let options = r#"{"sst_partition_prefix_len": 8, "max_file_opening_threads": 4,
+        "skip_stats_update_on_db_open": true, "skip_checking_sst_file_sizes_on_db_open": true}"#;
+    let db = DbInstance::new("rocksdb", &path, options).unwrap();
+    for name in ["a", "b", "c", "d"] {
+        let r = db
+            .run_default(&format!("?[count(k), sum(v)] := *{name}{{k, v}}"))
+            .unwrap()
+            .into_json();
+        assert_eq!(r["rows"], json!([[500, 124750.0]]));
+    }
+    assert!(storage_stat(&db, "startup_open_micros") > 0);
+    assert!(storage_stat(&db, "startup_initialize_micros") > 0);
+    // Present even when too quick to measure
+    storage_stat(&db, "startup_load_options_micros");
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn incremental_backup_rocksdb() {
+    use crate::storage::rocks::{
+        list_cozo_rocksdb_backups, restore_cozo_rocksdb_backup, verify_cozo_rocksdb_backup,
+        RocksDbBackupOptions,
+    };
+
+    let (db, path) = temp_rocksdb("incremental_backup");
+    let storage = match &db {
+        DbInstance::RocksDb(db) => db.storage(),
+        _ => unreachable!(),
+    };
+    let backup_dir = std::env::temp_dir().join("_cozo_test_incremental_backup_dir");
+    let _ = std::fs::remove_dir_all(&backup_dir);
+    let opts = RocksDbBackupOptions {
+        threads: Some(2),
+        verify: true,
+        ..Default::default()
+    };
+    db.run_default("?[k] := k in int_range(1000) :create r {k}")
+        .unwrap();
+    let first = storage.incremental_backup(&backup_dir, &opts).unwrap();
+    db.run_default("?[k] := k in int_range(1000, 2000) :put r {k}")
+        .unwrap();
+    let second = storage.incremental_backup(&backup_dir, &opts).unwrap();
+    let backups = list_cozo_rocksdb_backups(&backup_dir).unwrap();
+    assert_eq!(
+        backups.iter().map(|b| b.backup_id).collect_vec(),
+        vec![first, second]
+    );
+    let checksums = RocksDbBackupOptions {
+        verify_checksums: true,
+        ..Default::default()
+    };
+    verify_cozo_rocksdb_backup(&backup_dir, first, &checksums).unwrap();
+    verify_cozo_rocksdb_backup(&backup_dir, second, &checksums).unwrap();
+
+    let count = |db: &DbInstance| {
+        db.run_default("?[count(k)] := *r{k}").unwrap().into_json()["rows"].clone()
+    };
+    let restored = std::env::temp_dir().join("_cozo_test_incremental_backup_restored");
+    for (backup_id, expected) in [(Some(first), 1000), (None, 2000)] {
+        let _ = std::fs::remove_dir_all(&restored);
+        restore_cozo_rocksdb_backup(&backup_dir, backup_id, &restored, &opts).unwrap();
+        let restored_db = DbInstance::new("rocksdb", &restored, "").unwrap();
+        assert_eq!(count(&restored_db), json!([[expected]]));
+        drop(restored_db);
+        // Restoring over an existing database is refused
+        assert!(restore_cozo_rocksdb_backup(&backup_dir, backup_id, &restored, &opts).is_err());
+    }
+
+    // Older backups are purged once a new one is taken
+    let keep_one = RocksDbBackupOptions {
+        num_to_keep: Some(1),
+        ..Default::default()
+    };
+    let third = storage.incremental_backup(&backup_dir, &keep_one).unwrap();
+    let backups = list_cozo_rocksdb_backups(&backup_dir).unwrap();
+    assert_eq!(
+        backups.iter().map(|b| b.backup_id).collect_vec(),
+        vec![third]
+    );
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+    let _ = std::fs::remove_dir_all(backup_dir);
+    let _ = std::fs::remove_dir_all(restored);
+}
+
+#[test]
+#[cfg(feature = "storage-rocksdb")]
+fn secondary_instance_rocksdb() {
+    let (primary, path) = temp_rocksdb("secondary_primary");
+    primary
+        .run_default("?[k] := k in int_range(1000) :create r {k}")
+        .unwrap();
+    let secondary_dir = std::env::temp_dir().join("_cozo_test_secondary_dir");
+    let _ = std::fs::remove_dir_all(&secondary_dir);
+    let options = json!({ "secondary_path": secondary_dir }).to_string();
+    let secondary = DbInstance::new("rocksdb", &path, &options).unwrap();
+    let count = |db: &DbInstance| {
+        db.run_default("?[count(k)] := *r{k}").unwrap().into_json()["rows"].clone()
+    };
+    assert_eq!(count(&secondary), json!([[1000]]));
+
+    // Changes of the primary show once the secondary catches up
+    primary
+        .run_default("?[k] := k in int_range(1000, 1500) :put r {k}")
+        .unwrap();
+    primary.run_default("?[k] <- [[1]] :create s {k}").unwrap();
+    assert_eq!(count(&secondary), json!([[1000]]));
+    match &secondary {
+        DbInstance::RocksDb(db) => db.storage().try_catch_up_with_primary().unwrap(),
+        _ => unreachable!(),
+    }
+    assert_eq!(count(&secondary), json!([[1500]]));
+    let r = secondary.run_default("?[k] := *s{k}").unwrap().into_json();
+    assert_eq!(r["rows"], json!([[1]]));
+    assert!(secondary.run_default("?[k] <- [[2]] :put s {k}").is_err());
+    drop(secondary);
+
+    // With an interval set, a background thread catches up
+    let options =
+        json!({ "secondary_path": secondary_dir, "catch_up_interval_ms": 20 }).to_string();
+    let secondary = DbInstance::new("rocksdb", &path, &options).unwrap();
+    primary
+        .run_default("?[k] := k in int_range(1500, 2000) :put r {k}")
+        .unwrap();
+    let deadline = std::time::Instant::now() + std::time::Duration::from_secs(10);
+    while count(&secondary) != json!([[2000]]) {
+        assert!(std::time::Instant::now() < deadline);
+        std::thread::sleep(std::time::Duration::from_millis(20));
+    }
+    drop(secondary);
+    drop(primary);
+
+    // A read-only instance of a closed database
+    let db = DbInstance::new("rocksdb", &path, r#"{"read_only": true}"#).unwrap();
+    assert_eq!(count(&db), json!([[2000]]));
+    assert!(db.run_default("?[k] <- [[2]] :put s {k}").is_err());
+    drop(db);
+    let _ = std::fs::remove_dir_all(path);
+    let _ = std::fs::remove_dir_all(secondary_dir);
+}
@@ -6,11 +6,15 @@
  * You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
+use std::collections::BTreeSet;
+use std::path::Path;
+
 use itertools::Itertools;
-use miette::Result;
+use miette::{Diagnostic, Result};
+use thiserror::Error;
 
 use crate::data::tuple::Tuple;
-use crate::data::value::ValidityTs;
+use crate::data::value::{DataValue, ValidityTs};
 use crate::decode_tuple_from_kv;
 
 pub(crate) mod mem;
@@ -25,6 +29,74 @@ pub(crate) mod temp;
 pub(crate) mod tikv;
 // pub(crate) mod re;
 
+/// Returned from committing a transaction that conflicted with a concurrent one.
+/// The transaction has been rolled back, and running it again may succeed.
+#[derive(Debug, Diagnostic, Error)]
+#[error("Transaction conflicted with a concurrent transaction and was rolled back: {0}")]
+#[diagnostic(code(storage::tx_conflict))]
+#[diagnostic(help("The transaction can be retried"))]
+pub(crate) struct TransactionConflict(pub(crate) String);
+
+/// Statistics of a stored relation that the engine maintains as it writes its files,
+/// so that reading them does not scan the relation. Rows not yet written out are not counted,
+/// and overwritten rows may be counted more than once until compacted away.
+#[derive(Debug, Clone, Default)]
+pub struct RelationStats {
+    /// Number of files holding rows of the relation
+    pub num_files: usize,
+    /// Number of rows
+    pub num_rows: usize,
+    /// Total size of the keys of the rows
+    pub key_bytes: usize,
+    /// Total size of the values of the rows
+    pub value_bytes: usize,
+    /// Approximate number of distinct values of the first key column
+    pub distinct_first_keys: usize,
+}
+
+/// Returned when a transaction gave up waiting for a lock held by a concurrent transaction.
+/// Running it again may succeed.
+#[derive(Debug, Diagnostic, Error)]
+#[error("Transaction timed out waiting for a lock held by a concurrent transaction: {0}")]
+#[diagnostic(code(storage::lock_timeout))]
+#[diagnostic(help("The transaction can be retried, or the lock timeout raised"))]
+pub(crate) struct LockTimeout(pub(crate) String);
+
+/// Returned when a transaction was aborted to break a deadlock with concurrent transactions.
+/// Running it again may succeed.
+#[derive(Debug, Diagnostic, Error)]
+#[error("Transaction was aborted to break a deadlock: {0}")]
+#[diagnostic(code(storage::deadlock))]
+#[diagnostic(help("The transaction can be retried"))]
+pub(crate) struct Deadlock(pub(crate) String);
+
+/// Returned on writes to a database opened as a read-only secondary instance.
+#[derive(Debug, Diagnostic, Error)]
+#[error("The database is opened read-only")]
+#[diagnostic(code(storage::read_only))]
+#[diagnostic(help("Writes must go to an instance opened for writing"))]
+pub(crate) struct ReadOnlyStorage;
+
+/// Kinds of writes read back from the log of a storage engine.
+#[derive(Debug, Clone, Copy, Eq, PartialEq)]
+pub enum LoggedOp {
+    Put,
+    Delete,
+    Merge,
+    DeleteRange,
+}
+
+/// A write read back from the log of a storage engine, see [Storage::logged_writes_since].
+#[derive(Debug, Clone)]
+pub struct LoggedWrite {
+    pub seq: u64,
+    pub op: LoggedOp,
+    /// The key, or the start of the range for `DeleteRange`
+    pub key: Vec<u8>,
+    /// The value of puts, the operand of merges, or the end of the range for `DeleteRange`
+    pub val: Vec<u8>,
+}
+
 /// Swappable storage trait for Cozo's storage engine
 pub trait Storage<'s>: Send + Sync + Clone {
     /// The associated transaction type used by this engine
@@ -47,6 +119,36 @@ pub trait Storage<'s>: Send + Sync + Clone {
         &'a self,
         data: Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>> + 'a>,
     ) -> Result<()>;
+
+    /// Write a consistent copy of the database to `out_dir` that the engine can open as a database,
+    /// in a way cheaper than copying every key, such as by hard-linking immutable files.
+    /// Returns `false` if the engine cannot, which is what the default implementation does.
+    fn checkpoint(&'s self, _out_dir: &Path) -> Result<bool> {
+        Ok(false)
+    }
+
+    /// Up to `limit` committed writes with sequence numbers from `seq` on, oldest first, read back
+    /// from a log the engine keeps durably. Returns `None` if the engine keeps no such log,
+    /// which is what the default implementation does.
+    fn logged_writes_since(&'s self, _seq: u64, _limit: usize) -> Result<Option<Vec<LoggedWrite>>> {
+        Ok(None)
+    }
+
+    /// Engine-specific statistics as name-value pairs, reported by `::storage_stats`.
+    /// The default implementation reports nothing.
+    fn storage_stats(&'s self) -> Result<Vec<(String, DataValue)>> {
+        Ok(vec![])
+    }
+
+    /// Start counting the storage work done on the calling thread, for `::analyze`.
+    /// The default implementation does nothing.
+    fn start_perf_counters(&'s self) {}
+
+    /// Stop counting, and return the counts since `start_perf_counters` as name-value pairs.
+    /// The default implementation reports nothing.
+    fn stop_perf_counters(&'s self) -> Vec<(String, DataValue)> {
+        vec![]
+    }
 }
 
 /// Trait for the associated transaction type of a storage engine.
@@ -79,6 +181,18 @@ pub trait StoreTx<'s>: Sync {
         panic!("par_put is not supported")
     }
 
+    /// Should return true if the engine can combine merge operands written by `merge`
+    /// with stored values by itself, false otherwise. The default is false.
+    fn supports_merge(&self) -> bool {
+        false
+    }
+
+    /// Write a merge operand produced by `:accumulate` for a key, without reading its value.
+    /// It is OK to always panic if `supports_merge` returns `false`.
+    fn merge(&mut self, _key: &[u8], _operand: &[u8]) -> Result<()> {
+        panic!("merge is not supported")
+    }
+
     /// Delete a key-value pair from the storage.
     fn del(&mut self, key: &[u8]) -> Result<()>;
 
@@ -92,11 +206,38 @@ pub trait StoreTx<'s>: Sync {
     /// Delete a range from persisted data only.
     fn del_range_from_persisted(&mut self, lower: &[u8], upper: &[u8]) -> Result<()>;
 
+    /// Called when a stored relation or index with the given id and name is created,
+    /// before any of its data is written. The default implementation does nothing.
+    fn relation_created(&mut self, _id: u64, _name: &str) -> Result<()> {
+        Ok(())
+    }
+
+    /// Called when opening the database with the ids of all existing stored relations and
+    /// indices, so that the storage engine can clean up what it set up in `relation_created`
+    /// for relations whose creation never committed. Takes effect once the transaction commits.
+    /// The default implementation does nothing.
+    fn relations_loaded(&mut self, _ids: &BTreeSet<u64>) -> Result<()> {
+        Ok(())
+    }
+
+    /// Called when the retention of a relation is set or loaded. Versions of its rows that are
+    /// older than `retention_micros` and superseded at that point may be garbage collected by
+    /// the storage engine; `None` keeps all versions. Takes effect once the transaction commits.
+    /// The default implementation keeps all versions.
+    fn set_relation_retention(&mut self, _id: u64, _retention_micros: Option<i64>) -> Result<()> {
+        Ok(())
+    }
+
     /// Check if a key exists. If `for_update` is `true` (only possible in a write transaction),
     /// then the database needs to guarantee that `commit()` can only succeed if
     /// the key has not been modified outside the transaction.
     fn exists(&self, key: &[u8], for_update: bool) -> Result<bool>;
 
+    /// Check if multiple keys exist, with the same semantics of `for_update` as in `multi_get`.
+    fn multi_exists(&self, keys: &[Vec<u8>], for_update: bool) -> Result<Vec<bool>> {
+        keys.iter().map(|k| self.exists(k, for_update)).collect()
+    }
+
     /// Commit a transaction. Must return an `Err` if MVCC consistency cannot be guaranteed,
     /// and discard all changes introduced by this transaction.
     fn commit(&mut self) -> Result<()>;
@@ -156,6 +297,18 @@ pub trait StoreTx<'s>: Sync {
     where
         's: 'a;
 
+    /// Estimate the number of rows in the range without scanning it, for query planning.
+    /// Returns `None` if the engine cannot estimate cheaply, which is the default.
+    fn range_count_estimate(&self, _lower: &[u8], _upper: &[u8]) -> Result<Option<usize>> {
+        Ok(None)
+    }
+
+    /// Statistics of the stored relation with the given id, if the engine maintains them.
+    /// The default is `None`.
+    fn relation_stats(&self, _relation_id: u64) -> Result<Option<RelationStats>> {
+        Ok(None)
+    }
+
     /// Scan for all rows. The rows are required to be in ascending order.
     fn total_scan<'a>(&'a self) -> Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>> + 'a>
     where
@@ -6,31 +6,368 @@
  * You can obtain one at https://mozilla.org/MPL/2.0/.
  */
 
+use std::collections::{BTreeMap, BTreeSet};
 use std::fs;
+use std::ops::{Deref, DerefMut};
 use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
 
-use log::info;
-use miette::{miette, IntoDiagnostic, Result, WrapErr};
+use crossbeam::channel::{bounded, unbounded, RecvTimeoutError, Sender};
+use itertools::Itertools;
+use log::{error, info, warn};
+use miette::{bail, miette, IntoDiagnostic, Result, WrapErr};
 
-use cozorocks::{DbBuilder, DbIter, RocksDb, Tx};
+use cozorocks::{
+    BackupEntry, BackupOpts, CfOpts, DbBuilder, DbIter, DbSnapshot, IterBuilder, RocksDb,
+    RocksDbStatus, RowBatch, Tx,
+};
 
-use crate::data::tuple::{check_key_for_validity, Tuple};
-use crate::data::value::ValidityTs;
+use crate::data::tuple::{check_key_for_validity, Tuple, ENCODED_KEY_MIN_LEN};
+use crate::data::value::{DataValue, ValidityTs};
+use crate::query::stored::merge_accumulated;
 use crate::runtime::db::{BadDbInit, DbManifest};
 use crate::runtime::relation::{decode_tuple_from_kv, extend_tuple_from_v};
-use crate::storage::{Storage, StoreTx};
+use crate::storage::{
+    Deadlock, LockTimeout, LoggedOp, LoggedWrite, ReadOnlyStorage, RelationStats, Storage, StoreTx,
+    TransactionConflict,
+};
 use crate::utils::swap_option_result;
 use crate::Db;
 
 const KEY_PREFIX_LEN: usize = 9;
+const DEFAULT_BULK_LOAD_BATCH_SIZE: usize = 4 << 20;
+const DEFAULT_WRITE_BATCH_FLUSH_THRESHOLD: usize = 16 << 20;
+/// Amount of data written to each SST file by bulk loads
+const BULK_LOAD_SST_SIZE: usize = 64 << 20;
 const CURRENT_STORAGE_VERSION: u64 = 3;
+const DEFAULT_REMOVAL_COMPACTION_DELAY_MS: u64 = 10_000;
+/// Number of rows a transaction must delete from a range for the range to be compacted afterwards
+const REMOVAL_COMPACTION_MIN_ROWS: usize = 10_000;
+
+/// Tuning options for the RocksDB storage engine.
+/// When using [DbInstance](crate::DbInstance), they are given as a JSON object in the `options` argument,
+/// and any field left out takes its default value.
+#[derive(Debug, Clone, Default, serde_derive::Deserialize)]
+#[serde(default)]
+pub struct RocksDbOptions {
+    /// Size in bytes of the block cache shared by all tables. Zero keeps the RocksDB default.
+    pub block_cache_size: usize,
+    /// Use HyperClockCache instead of LRU for the block cache.
+    pub hyper_clock_cache: bool,
+    /// Size in bytes of the row cache. Zero disables the row cache.
+    pub row_cache_size: usize,
+    /// Split index and filter blocks of tables into partitions that are cached as needed,
+    /// keeping only a small top-level index pinned. Recommended for databases much larger than
+    /// the block cache, where whole index and filter blocks would crowd out data blocks.
+    pub partitioned_index_filters: bool,
+    /// Use Ribbon filters instead of Bloom filters: about 30% smaller for the same false
+    /// positive rate, but more expensive to build.
+    pub ribbon_filter: bool,
+    /// Size filters to reduce memory lost to allocator fragmentation.
+    pub optimize_filters_for_memory: bool,
+    /// Cut SST files where the first this many bytes of keys change. With 8, the length of
+    /// relation ids, every file holds the rows of a single relation, and the files of a
+    /// destroyed relation are deleted whole instead of being rewritten by compactions.
+    pub sst_partition_prefix_len: Option<usize>,
+    /// Threads opening SST files in parallel when the database is opened. Defaults to 16.
+    pub max_file_opening_threads: Option<usize>,
+    /// Do not read every SST file on open to load the statistics used for compaction decisions.
+    /// Speeds up opening large databases, at the cost of less informed compactions for a while.
+    pub skip_stats_update_on_db_open: bool,
+    /// Do not check the sizes of all SST files against the manifest on open.
+    pub skip_checking_sst_file_sizes_on_db_open: bool,
+    /// Open the database as a read-only secondary instance of a primary that may be running in
+    /// another process, keeping the secondary's own files in this directory. Several secondaries,
+    /// each with its own directory, can serve reads of the same data.
+    pub secondary_path: Option<String>,
+    /// How often a secondary instance applies the changes of its primary, in milliseconds.
+    /// When unset, it only does so when [RocksDbStorage::try_catch_up_with_primary] is called.
+    pub catch_up_interval_ms: Option<u64>,
+    /// Open an existing database read-only, without writing anything to its directory or
+    /// starting background work. Reads see the data as of opening. A process writing to the
+    /// database meanwhile may delete files they need. Ignored if `secondary_path` is set.
+    pub read_only: bool,
+    /// Keep write-ahead log files for at least this many seconds after their data is flushed,
+    /// so that [Db::changes_since] can still read changes that old.
+    pub wal_ttl_seconds: Option<u64>,
+    /// Delete retained write-ahead log files, oldest first, once they take up more than this
+    /// many megabytes together.
+    pub wal_size_limit_mb: Option<u64>,
+    /// Delay in milliseconds before the key ranges of removed relations, and ranges where a
+    /// transaction deleted many rows, are compacted in the background, clearing their tombstones
+    /// out of the way of later scans. Removals within the delay are compacted together.
+    /// Defaults to 10 seconds; zero disables the compactions.
+    pub removal_compaction_delay_ms: Option<u64>,
+    /// Collect RocksDB statistics, which are needed for the cache hit and miss counters
+    /// reported by `::storage_stats`.
+    pub enable_statistics: bool,
+    /// Use optimistic transactions, which take no locks and instead fail on commit
+    /// if they conflict with a concurrent transaction. Suits read-mostly workloads with rare,
+    /// low-contention writes. Conflicting transactions can be retried.
+    pub optimistic_transactions: bool,
+    /// Size in bytes at which bulk loads, such as restoring from a backup, write out their
+    /// accumulated batch. Zero uses the default of 4 MiB.
+    pub bulk_load_batch_size: usize,
+    /// Skip the write-ahead log during bulk loads and flush once at the end instead.
+    /// Much faster, but an interrupted load leaves the database in an unknown state,
+    /// which is acceptable when restoring into a new database.
+    pub bulk_load_disable_wal: bool,
+    /// When non-zero, bulk loads write sorted SST files on this many threads and ingest them
+    /// all at once at the end, bypassing the memtable and the write-ahead log.
+    /// Best for restoring large backups into a new database.
+    pub bulk_load_sst_threads: usize,
+    /// Give each stored relation and index created from now on its own column family,
+    /// so that it is compacted separately and removing it drops the column family
+    /// instead of writing a tombstone for every key.
+    pub relation_column_families: bool,
+    /// Number of stripes of the lock table of each column family, which bounds how many
+    /// transactions can take locks in parallel. Defaults to 16.
+    pub lock_stripes: Option<usize>,
+    /// How long a transaction waits for a lock held by another, in milliseconds, before failing
+    /// with a retryable lock timeout error. Negative values wait forever. Defaults to 1000.
+    pub lock_timeout_ms: Option<i64>,
+    /// Maximum number of keys locked at once in each column family, beyond which writes fail.
+    /// Unlimited by default.
+    pub max_num_locks: Option<i64>,
+    /// Detect deadlocks between transactions and abort one of them with a retryable error
+    /// right away, instead of waiting for the lock timeout.
+    pub deadlock_detect: bool,
+    /// How many wait-for edges deadlock detection follows. Defaults to 50.
+    pub deadlock_detect_depth: Option<i64>,
+    /// When transactions write their data to the memtable, one of `committed`, `prepared` or
+    /// `unprepared`. The default, `committed`, holds all writes of a transaction in memory until
+    /// it commits. `unprepared` writes them out as the transaction runs, so that transactions
+    /// writing millions of rows neither hold them all in memory nor pause long on commit.
+    /// Not available with optimistic transactions, nor together with `wal_ttl_seconds` or
+    /// `wal_size_limit_mb`, since [Db::changes_since] only works under `committed`.
+    /// Changing the policy of an existing database requires it to have been closed cleanly.
+    pub write_policy: Option<String>,
+    /// Size in bytes of the writes an `unprepared` transaction buffers before writing them out.
+    /// Defaults to 16 MiB.
+    pub write_batch_flush_threshold: Option<usize>,
+    /// Let the writers of one write group insert into the memtable while the next group is
+    /// writing the write-ahead log, which helps with many concurrent writers.
+    pub enable_pipelined_write: bool,
+    /// Let concurrent writers insert into the memtable in parallel. Enabled by default.
+    pub allow_concurrent_memtable_write: Option<bool>,
+    /// Do not wait for memtable inserts of earlier writes before publishing a write, for higher
+    /// throughput with many concurrent writers. Requires the `prepared` write policy, and cannot
+    /// be combined with `enable_pipelined_write`.
+    pub unordered_write: bool,
+    /// Size in bytes of each memtable. Larger memtables absorb more writes before flushing.
+    pub write_buffer_size: Option<usize>,
+    /// Number of memtables a column family may hold, full ones waiting to be flushed included,
+    /// before writes stall.
+    pub max_write_buffer_number: Option<usize>,
+    /// Memory budget in bytes for the memtables of all column families together. Once reached,
+    /// the largest memtables are flushed. Unbounded by default.
+    pub write_buffer_memory_budget: Option<usize>,
+    /// Column family options for relations not listed in `column_families`.
+    pub column_family_defaults: RocksDbColumnFamilyOptions,
+    /// Column family options by relation name. Indices are named `relation:index`.
+    pub column_families: BTreeMap<String, RocksDbColumnFamilyOptions>,
+}
+
+/// Options of the column family of a relation, see [RocksDbOptions].
+/// Settings left out are inherited from the database options.
+#[derive(Debug, Clone, Default, serde_derive::Deserialize)]
+#[serde(default)]
+pub struct RocksDbColumnFamilyOptions {
+    /// One of `none`, `snappy`, `lz4`, `lz4hc` or `zstd`.
+    pub compression: Option<String>,
+    /// One of `level`, `universal` or `fifo`.
+    pub compaction_style: Option<String>,
+    /// Size in bytes of data blocks.
+    pub block_size: Option<usize>,
+    /// Bits per key of the bloom filter.
+    pub bloom_filter_bits_per_key: Option<f64>,
+    /// Length of the key prefix used for prefix seeks.
+    pub prefix_len: Option<usize>,
+}
+
+impl RocksDbColumnFamilyOptions {
+    fn validate(&self) -> Result<()> {
+        if let Some(c) = &self.compression {
+            if !["none", "snappy", "lz4", "lz4hc", "zstd"].contains(&c.as_str()) {
+                bail!(BadDbInit(format!("unknown compression '{c}'")))
+            }
+        }
+        if let Some(c) = &self.compaction_style {
+            if !["level", "universal", "fifo"].contains(&c.as_str()) {
+                bail!(BadDbInit(format!("unknown compaction style '{c}'")))
+            }
+        }
+        Ok(())
+    }
+    fn to_cf_opts(&self, defaults: &Self) -> CfOpts {
+        CfOpts {
+            compression: self
+                .compression
+                .clone()
+                .or_else(|| defaults.compression.clone())
+                .unwrap_or_default(),
+            compaction_style: self
+                .compaction_style
+                .clone()
+                .or_else(|| defaults.compaction_style.clone())
+                .unwrap_or_default(),
+            block_size: self.block_size.or(defaults.block_size).unwrap_or(0),
+            bloom_filter_bits_per_key: self
+                .bloom_filter_bits_per_key
+                .or(defaults.bloom_filter_bits_per_key)
+                .unwrap_or(0.),
+            prefix_len: self.prefix_len.or(defaults.prefix_len).unwrap_or(0),
+        }
+    }
+}
+
+impl RocksDbOptions {
+    fn cf_opts_for(&self, name: &str) -> CfOpts {
+        match self.column_families.get(name) {
+            None => self
+                .column_family_defaults
+                .to_cf_opts(&RocksDbColumnFamilyOptions::default()),
+            Some(opts) => opts.to_cf_opts(&self.column_family_defaults),
+        }
+    }
+}
+
+/// Options of backups taken with the RocksDB backup engine,
+/// see [RocksDbStorage::incremental_backup].
+#[derive(Debug, Clone, Default, serde_derive::Deserialize)]
+#[serde(default)]
+pub struct RocksDbBackupOptions {
+    /// Threads copying files. Defaults to 1.
+    pub threads: Option<usize>,
+    /// Bytes per second read or written by backups and restores. Unlimited by default.
+    pub rate_limit: Option<u64>,
+    /// Purge older backups after taking a new one, so that this many are left.
+    /// All are kept by default.
+    pub num_to_keep: Option<u32>,
+    /// Verify a new backup once it is taken.
+    pub verify: bool,
+    /// Verify the checksums of files, not only their sizes.
+    pub verify_checksums: bool,
+}
+
+impl RocksDbBackupOptions {
+    fn to_bridge(&self, backup_dir: &Path) -> Result<BackupOpts> {
+        Ok(BackupOpts {
+            backup_dir: backup_dir
+                .to_str()
+                .ok_or_else(|| miette!("bad path name"))?
+                .to_string(),
+            threads: self.threads.unwrap_or(0) as i32,
+            rate_limit: self.rate_limit.unwrap_or(0),
+            num_to_keep: self.num_to_keep.unwrap_or(0),
+            verify: self.verify,
+            verify_checksums: self.verify_checksums,
+        })
+    }
+}
+
+/// The backups taken with [RocksDbStorage::incremental_backup] in `backup_dir`, oldest first.
+pub fn list_cozo_rocksdb_backups(backup_dir: impl AsRef<Path>) -> Result<Vec<BackupEntry>> {
+    let opts = RocksDbBackupOptions::default().to_bridge(backup_dir.as_ref())?;
+    Ok(cozorocks::list_backups(&opts)?)
+}
+
+/// Checks that the files of a backup in `backup_dir` are intact.
+pub fn verify_cozo_rocksdb_backup(
+    backup_dir: impl AsRef<Path>,
+    backup_id: u32,
+    opts: &RocksDbBackupOptions,
+) -> Result<()> {
+    let opts = opts.to_bridge(backup_dir.as_ref())?;
+    Ok(cozorocks::verify_backup(&opts, backup_id)?)
+}
+
+/// Restores a backup taken with [RocksDbStorage::incremental_backup], or the latest one
+/// if `backup_id` is `None`, as a new database at `path`, to be opened with [new_cozo_rocksdb].
+/// Files are copied in parallel as set in `opts`, instead of key by key as with
+/// [Db::restore_backup].
+pub fn restore_cozo_rocksdb_backup(
+    backup_dir: impl AsRef<Path>,
+    backup_id: Option<u32>,
+    path: impl AsRef<Path>,
+    opts: &RocksDbBackupOptions,
+) -> Result<()> {
+    let path = path.as_ref();
+    if path.join("manifest").exists() {
+        bail!(
+            "Cannot restore backup: a database exists at {}. \
+            You can only restore into a new database.",
+            path.to_string_lossy()
+        );
+    }
+    let data_path = path.join("data");
+    fs::create_dir_all(&data_path)
+        .into_diagnostic()
+        .wrap_err_with(|| "when creating database directory")?;
+    let data_path = data_path.to_str().ok_or_else(|| miette!("bad path name"))?;
+    let opts = opts.to_bridge(backup_dir.as_ref())?;
+    Ok(cozorocks::restore_backup(&opts, backup_id, data_path)?)
+}
 
 /// Creates a RocksDB database object.
 /// This is currently the fastest persistent storage and it can
 /// sustain huge concurrency.
 /// Supports concurrent readers and writers.
 pub fn new_cozo_rocksdb(path: impl AsRef<Path>) -> Result<Db<RocksDbStorage>> {
+    new_cozo_rocksdb_with_options(path, &RocksDbOptions::default())
+}
+
+/// Creates a RocksDB database object with the given tuning options.
+/// See [new_cozo_rocksdb].
+pub fn new_cozo_rocksdb_with_options(
+    path: impl AsRef<Path>,
+    opts: &RocksDbOptions,
+) -> Result<Db<RocksDbStorage>> {
+    if let Some(policy) = &opts.write_policy {
+        if !["committed", "prepared", "unprepared"].contains(&policy.as_str()) {
+            bail!(BadDbInit(format!("unknown write policy '{policy}'")))
+        }
+        if opts.optimistic_transactions && policy != "committed" {
+            bail!(BadDbInit(format!(
+                "write policy '{policy}' is not available with optimistic transactions"
+            )))
+        }
+        if (opts.wal_ttl_seconds.is_some() || opts.wal_size_limit_mb.is_some())
+            && policy != "committed"
+        {
+            bail!(BadDbInit(format!(
+                "write policy '{policy}' cannot be combined with retaining the write-ahead log \
+                for reading changes back"
+            )))
+        }
+    }
+    if opts.unordered_write {
+        if opts.write_policy.as_deref() != Some("prepared") {
+            bail!(BadDbInit(
+                "unordered writes require the 'prepared' write policy".to_string()
+            ))
+        }
+        if opts.enable_pipelined_write {
+            bail!(BadDbInit(
+                "unordered writes cannot be combined with pipelined writes".to_string()
+            ))
+        }
+    }
+    opts.column_family_defaults.validate()?;
+    for cf_opts in opts.column_families.values() {
+        cf_opts.validate()?;
+    }
     let builder = DbBuilder::default().path(path.as_ref());
+    let path_buf = PathBuf::from(path.as_ref());
+    if (opts.read_only || opts.secondary_path.is_some()) && !path_buf.join("manifest").exists() {
+        bail!(BadDbInit(format!(
+            "no database to open read-only at {}",
+            path_buf.to_string_lossy()
+        )))
+    }
     fs::create_dir_all(path.as_ref()).map_err(|err| {
         BadDbInit(format!(
             "cannot create directory {}: {}",
@@ -38,7 +375,6 @@ pub fn new_cozo_rocksdb(path: impl AsRef<Path>) -> Result<Db<RocksDbStorage>> {
             err
         ))
     })?;
-    let path_buf = PathBuf::from(path.as_ref());
 
     let is_new = {
         let mut manifest_path = path_buf.clone();
@@ -96,17 +432,84 @@ pub fn new_cozo_rocksdb(path: impl AsRef<Path>) -> Result<Db<RocksDbStorage>> {
         ""
     };
 
-    let db_builder = builder
+    let mut db_builder = builder
         .create_if_missing(is_new)
         .use_capped_prefix_extractor(true, KEY_PREFIX_LEN)
         .use_bloom_filter(true, 9.9, true)
+        .use_ribbon_filter(opts.ribbon_filter)
+        .partition_index_filters(opts.partitioned_index_filters)
+        .optimize_filters_for_memory(opts.optimize_filters_for_memory)
+        .sst_partition_prefix_len(opts.sst_partition_prefix_len.unwrap_or(0))
+        .max_file_opening_threads(opts.max_file_opening_threads.unwrap_or(0) as i32)
+        .skip_open_checks(
+            opts.skip_stats_update_on_db_open,
+            opts.skip_checking_sst_file_sizes_on_db_open,
+        )
+        .block_cache(opts.block_cache_size, opts.hyper_clock_cache)
+        .row_cache(opts.row_cache_size)
+        .enable_statistics(opts.enable_statistics)
+        .optimistic(opts.optimistic_transactions)
         .path(store_path)
         .options_path(options_path);
+    if opts.wal_ttl_seconds.is_some() || opts.wal_size_limit_mb.is_some() {
+        db_builder = db_builder.wal_retention(
+            opts.wal_ttl_seconds.unwrap_or(0),
+            opts.wal_size_limit_mb.unwrap_or(0),
+        );
+    }
+    if let Some(secondary_path) = &opts.secondary_path {
+        db_builder = db_builder.secondary_path(secondary_path);
+    } else if opts.read_only {
+        db_builder = db_builder.read_only(true);
+    }
+    if let Some(stripes) = opts.lock_stripes {
+        db_builder = db_builder.lock_stripes(stripes);
+    }
+    if let Some(timeout) = opts.lock_timeout_ms {
+        db_builder = db_builder.lock_timeout_ms(timeout);
+    }
+    if let Some(max_locks) = opts.max_num_locks {
+        db_builder = db_builder.max_num_locks(max_locks);
+    }
+    if let Some(policy) = &opts.write_policy {
+        let threshold = opts
+            .write_batch_flush_threshold
+            .unwrap_or(DEFAULT_WRITE_BATCH_FLUSH_THRESHOLD);
+        db_builder = db_builder.write_policy(policy, threshold as i64);
+    }
+    db_builder = db_builder
+        .enable_pipelined_write(opts.enable_pipelined_write)
+        .allow_concurrent_memtable_write(opts.allow_concurrent_memtable_write.unwrap_or(true))
+        .unordered_write(opts.unordered_write)
+        .write_buffers(
+            opts.write_buffer_size.unwrap_or(0),
+            opts.max_write_buffer_number.unwrap_or(0),
+        )
+        .write_buffer_manager(opts.write_buffer_memory_budget.unwrap_or(0));
+    if opts.deadlock_detect {
+        db_builder = db_builder.deadlock_detect(true, opts.deadlock_detect_depth.unwrap_or(50));
+    }
 
+    // Merge operands written by `:accumulate` are combined by Rust code
+    cozorocks::set_merge_fn(merge_accumulated);
     let db = db_builder.build()?;
 
-    let ret = Db::new(RocksDbStorage::new(db))?;
+    let ret = Db::new(RocksDbStorage::new(db, opts.clone()))?;
+    let init_start = Instant::now();
     ret.initialize()?;
+    let initialize_micros = init_start.elapsed().as_micros() as u64;
+    let storage = ret.storage();
+    storage
+        .initialize_micros
+        .store(initialize_micros, Ordering::Relaxed);
+    let timings = storage.db.open_timings();
+    info!(
+        "RocksDB storage engine started in {} ms: loading options {} ms, opening the database {} ms, initializing {} ms",
+        (timings.load_options_micros + timings.open_micros + initialize_micros) / 1000,
+        timings.load_options_micros / 1000,
+        timings.open_micros / 1000,
+        initialize_micros / 1000,
+    );
     Ok(ret)
 }
 
@@ -114,11 +517,249 @@ pub fn new_cozo_rocksdb(path: impl AsRef<Path>) -> Result<Db<RocksDbStorage>> {
 #[derive(Clone)]
 pub struct RocksDbStorage {
     db: RocksDb,
+    options: Arc<RocksDbOptions>,
+    /// Time taken by `Db::initialize` when the database was opened
+    initialize_micros: Arc<AtomicU64>,
+    _catch_up: Option<Arc<CatchUpStopper>>,
+    compactions: Option<CompactionScheduler>,
+}
+
+/// Stops the thread that keeps a secondary instance caught up with its primary once
+/// the last handle of the storage is dropped.
+struct CatchUpStopper(Arc<AtomicBool>);
+
+impl Drop for CatchUpStopper {
+    fn drop(&mut self) {
+        self.0.store(true, Ordering::Release);
+    }
+}
+
+/// Compacts key ranges freed by removals in a background thread. The thread ends once the storage
+/// and all its transactions are dropped, leaving any ranges it has not got to yet to the automatic
+/// compactions.
+#[derive(Clone)]
+struct CompactionScheduler {
+    sender: Sender<(Vec<u8>, Vec<u8>)>,
+    /// Ranges scheduled and not yet compacted
+    pending: Arc<AtomicU64>,
+}
+
+impl CompactionScheduler {
+    fn start(db: RocksDb, delay: Duration) -> Self {
+        let (sender, receiver) = unbounded::<(Vec<u8>, Vec<u8>)>();
+        let pending: Arc<AtomicU64> = Default::default();
+        let thread_pending = pending.clone();
+        thread::spawn(move || {
+            while let Ok(first) = receiver.recv() {
+                let mut ranges = vec![first];
+                let deadline = Instant::now() + delay;
+                loop {
+                    match receiver.recv_deadline(deadline) {
+                        Ok(range) => ranges.push(range),
+                        Err(RecvTimeoutError::Timeout) => break,
+                        Err(RecvTimeoutError::Disconnected) => return,
+                    }
+                }
+                let n_ranges = ranges.len() as u64;
+                for (lower, upper) in coalesce_ranges(ranges) {
+                    if let Err(err) = db.range_compact(&lower, &upper) {
+                        error!("cannot compact range freed by removal: {err}");
+                    }
+                }
+                thread_pending.fetch_sub(n_ranges, Ordering::Relaxed);
+            }
+        });
+        Self { sender, pending }
+    }
+
+    fn schedule(&self, lower: Vec<u8>, upper: Vec<u8>) {
+        self.pending.fetch_add(1, Ordering::Relaxed);
+        // Cannot fail while a sender is alive, as the thread only ends when none is left
+        let _ = self.sender.send((lower, upper));
+    }
+}
+
+/// Sorts ranges and merges those that overlap or touch, such as those of relations created one
+/// after another, so that each stretch is compacted once.
+fn coalesce_ranges(mut ranges: Vec<(Vec<u8>, Vec<u8>)>) -> Vec<(Vec<u8>, Vec<u8>)> {
+    ranges.sort();
+    let mut ret: Vec<(Vec<u8>, Vec<u8>)> = Vec::with_capacity(ranges.len());
+    for (lower, upper) in ranges {
+        match ret.last_mut() {
+            Some((_, last_upper)) if lower <= *last_upper => {
+                if upper > *last_upper {
+                    *last_upper = upper;
+                }
+            }
+            _ => ret.push((lower, upper)),
+        }
+    }
+    ret
 }
 
 impl RocksDbStorage {
-    pub(crate) fn new(db: RocksDb) -> Self {
-        Self { db }
+    pub(crate) fn new(db: RocksDb, options: RocksDbOptions) -> Self {
+        let catch_up = match options.catch_up_interval_ms {
+            Some(interval) if db.is_secondary() => {
+                let stopped: Arc<AtomicBool> = Default::default();
+                let db = db.clone();
+                let thread_stopped = stopped.clone();
+                thread::spawn(move || loop {
+                    thread::sleep(Duration::from_millis(interval));
+                    if thread_stopped.load(Ordering::Acquire) {
+                        break;
+                    }
+                    if let Err(err) = db.try_catch_up_with_primary() {
+                        error!("secondary instance cannot catch up with primary: {err}");
+                    }
+                });
+                Some(Arc::new(CatchUpStopper(stopped)))
+            }
+            _ => None,
+        };
+        let delay = options
+            .removal_compaction_delay_ms
+            .unwrap_or(DEFAULT_REMOVAL_COMPACTION_DELAY_MS);
+        let compactions = if delay == 0 || db.is_read_only() {
+            None
+        } else {
+            Some(CompactionScheduler::start(
+                db.clone(),
+                Duration::from_millis(delay),
+            ))
+        };
+        Self {
+            db,
+            options: Arc::new(options),
+            initialize_micros: Default::default(),
+            _catch_up: catch_up,
+            compactions,
+        }
+    }
+
+    /// Apply the changes the primary made since this secondary instance was opened or last
+    /// caught up. Relations the primary created in their own column families in the meantime
+    /// only become visible when the secondary is reopened. Fails if the database is not
+    /// opened as a secondary instance.
+    pub fn try_catch_up_with_primary(&self) -> Result<()> {
+        Ok(self.db.try_catch_up_with_primary()?)
+    }
+
+    #[cfg(test)]
+    pub(crate) fn relation_cf_ids(&self) -> Vec<u64> {
+        self.db.relation_cf_ids()
+    }
+}
+
+impl RocksDbStorage {
+    /// Take a backup into `backup_dir` with the RocksDB backup engine. Backups in the same
+    /// directory share the SST files they have in common, so only the files written since
+    /// the previous backup are copied. Returns the id of the new backup, which can be given
+    /// to [restore_cozo_rocksdb_backup].
+    pub fn incremental_backup(
+        &self,
+        backup_dir: impl AsRef<Path>,
+        opts: &RocksDbBackupOptions,
+    ) -> Result<u32> {
+        let backup_dir = backup_dir.as_ref();
+        fs::create_dir_all(backup_dir)
+            .into_diagnostic()
+            .wrap_err_with(|| "when creating backup directory")?;
+        let opts = opts.to_bridge(backup_dir)?;
+        Ok(self.db.create_backup(&opts)?)
+    }
+
+    /// Splits the sorted `data` into chunks that worker threads write as SST files,
+    /// which are then ingested in one go. A chunk never spans two column families.
+    fn sst_batch_put<'a>(
+        &'a self,
+        data: Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>> + 'a>,
+        threads: usize,
+    ) -> Result<()> {
+        let mut dir = PathBuf::from(self.db.db_path());
+        dir.push("bulk_load");
+        fs::create_dir_all(&dir)
+            .into_diagnostic()
+            .wrap_err_with(|| "when creating directory for bulk load")?;
+        let cf_ids = self.db.relation_cf_ids();
+        // Relations without their own column family are written for relation 0, which lives in the default one
+        let cf_relation_of = |key: &[u8]| {
+            relation_id_of(key)
+                .filter(|id| cf_ids.contains(id))
+                .unwrap_or(0)
+        };
+
+        let files = thread::scope(|s| -> Result<Vec<(usize, String, u64)>> {
+            let (chunk_sender, chunk_receiver) =
+                bounded::<(usize, u64, Vec<(Vec<u8>, Vec<u8>)>)>(threads);
+            let (file_sender, file_receiver) = unbounded();
+            let workers = (0..threads)
+                .map(|_| {
+                    let chunk_receiver = chunk_receiver.clone();
+                    let file_sender = file_sender.clone();
+                    let dir = &dir;
+                    let db = &self.db;
+                    s.spawn(move || -> Result<()> {
+                        for (seq, relation_id, rows) in chunk_receiver {
+                            let path = dir.join(format!("{seq}.sst")).to_string_lossy().to_string();
+                            let mut writer = db.get_sst_writer(&path, relation_id)?;
+                            for (k, v) in &rows {
+                                writer.put(k, v)?;
+                            }
+                            writer.finish()?;
+                            let _ = file_sender.send((seq, path, relation_id));
+                        }
+                        Ok(())
+                    })
+                })
+                .collect_vec();
+            drop(chunk_receiver);
+            drop(file_sender);
+
+            let produced = (|| -> Result<()> {
+                let mut seq = 0;
+                let mut chunk = vec![];
+                let mut chunk_size = 0;
+                let mut chunk_relation = 0;
+                for result in data {
+                    let (key, val) = result?;
+                    let relation = cf_relation_of(&key);
+                    if !chunk.is_empty()
+                        && (chunk_size >= BULK_LOAD_SST_SIZE || relation != chunk_relation)
+                    {
+                        chunk_sender
+                            .send((seq, chunk_relation, std::mem::take(&mut chunk)))
+                            .map_err(|_| miette!("bulk load workers stopped unexpectedly"))?;
+                        seq += 1;
+                        chunk_size = 0;
+                    }
+                    chunk_relation = relation;
+                    chunk_size += key.len() + val.len();
+                    chunk.push((key, val));
+                }
+                if !chunk.is_empty() {
+                    chunk_sender
+                        .send((seq, chunk_relation, chunk))
+                        .map_err(|_| miette!("bulk load workers stopped unexpectedly"))?;
+                }
+                Ok(())
+            })();
+            drop(chunk_sender);
+            for worker in workers {
+                worker.join().unwrap()?;
+            }
+            produced?;
+            Ok(file_receiver.into_iter().collect_vec())
+        });
+
+        let result = files.and_then(|mut files| {
+            files.sort_by_key(|(seq, _, _)| *seq);
+            let (paths, relation_ids): (Vec<_>, Vec<_>) =
+                files.into_iter().map(|(_, path, id)| (path, id)).unzip();
+            Ok(self.db.ingest_sst_files(&paths, &relation_ids)?)
+        });
+        let _ = fs::remove_dir_all(&dir);
+        result
     }
 }
 
@@ -129,42 +770,427 @@ impl Storage<'_> for RocksDbStorage {
         "rocksdb"
     }
 
-    fn transact(&self, _write: bool) -> Result<Self::Tx> {
-        let db_tx = self.db.transact().set_snapshot(true).start();
-        Ok(RocksDbTx { db_tx })
+    fn transact(&self, write: bool) -> Result<Self::Tx> {
+        // A read-only instance cannot write, so writes fail when they are attempted
+        let db_tx = if write && !self.db.is_read_only() {
+            RocksDbTxKind::Writer(self.db.transact().set_snapshot(true).start())
+        } else {
+            RocksDbTxKind::Reader(self.db.snapshot())
+        };
+        Ok(RocksDbTx {
+            iter_pool: IterPool::default(),
+            db_tx,
+            db: self.db.clone(),
+            options: self.options.clone(),
+            dropped_cfs: vec![],
+            created_cfs: vec![],
+            dropped_ranges: vec![],
+            purged_ranges: vec![],
+            compactions: self.compactions.clone(),
+            retention_changes: vec![],
+        })
     }
 
     fn range_compact(&self, lower: &[u8], upper: &[u8]) -> Result<()> {
         self.db.range_compact(lower, upper).into_diagnostic()
     }
 
+    /// The copy has the layout of the directory the database was opened from: the manifest
+    /// and options file are copied, and the RocksDB files are checkpointed into `data`.
+    fn checkpoint(&self, out_dir: &Path) -> Result<bool> {
+        if out_dir.exists() {
+            bail!(
+                "Cannot create backup: {} already exists",
+                out_dir.to_string_lossy()
+            );
+        }
+        let data_path = PathBuf::from(self.db.db_path());
+        let root = data_path.parent().ok_or_else(|| miette!("bad path name"))?;
+        fs::create_dir_all(out_dir)
+            .into_diagnostic()
+            .wrap_err_with(|| "when creating backup directory")?;
+        for name in ["manifest", "options"] {
+            let src = root.join(name);
+            if src.exists() {
+                fs::copy(&src, out_dir.join(name))
+                    .into_diagnostic()
+                    .wrap_err_with(|| format!("when copying {name} to backup"))?;
+            }
+        }
+        let out_data = out_dir.join("data");
+        let out_data = out_data.to_str().ok_or_else(|| miette!("bad path name"))?;
+        self.db.create_checkpoint(out_data)?;
+        Ok(true)
+    }
+
     fn batch_put<'a>(
         &'a self,
         data: Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>> + 'a>,
     ) -> Result<()> {
+        if self.options.bulk_load_sst_threads > 0 {
+            return self.sst_batch_put(data, self.options.bulk_load_sst_threads);
+        }
+        let batch_size = match self.options.bulk_load_batch_size {
+            0 => DEFAULT_BULK_LOAD_BATCH_SIZE,
+            size => size,
+        };
+        let mut batch = self.db.write_batch(self.options.bulk_load_disable_wal);
         for result in data {
             let (key, val) = result?;
-            self.db.raw_put(&key, &val)?;
+            batch.put(&key, &val)?;
+            if batch.data_size() >= batch_size {
+                batch.commit()?;
+            }
+        }
+        if !batch.is_empty() {
+            batch.commit()?;
+        }
+        if self.options.bulk_load_disable_wal {
+            self.db.flush()?;
         }
         Ok(())
     }
+
+    /// Writes are read back from the write-ahead log, which only holds them until their data
+    /// is flushed unless `wal_ttl_seconds` or `wal_size_limit_mb` is set.
+    ///
+    /// Only the `committed` write policy is supported: under the others, the log also holds
+    /// the writes of transactions that are not yet committed or were rolled back, and sequence
+    /// numbers are assigned per batch instead of per write.
+    fn logged_writes_since(&self, seq: u64, limit: usize) -> Result<Option<Vec<LoggedWrite>>> {
+        if let Some(policy) = &self.options.write_policy {
+            if policy != "committed" {
+                bail!("changes cannot be read back under the '{policy}' write policy")
+            }
+        }
+        let mut ret = vec![];
+        if seq > self.db.latest_sequence_number() {
+            return Ok(Some(ret));
+        }
+        let mut iter = self.db.updates_since(seq)?;
+        // The first batch may start before `seq`
+        while ret.len() < limit {
+            let batch = match iter.next_batch()? {
+                Some(batch) => batch,
+                None => break,
+            };
+            for entry in batch {
+                if entry.seq < seq {
+                    continue;
+                }
+                if ret.len() == limit {
+                    break;
+                }
+                let op = match entry.op {
+                    cozorocks::WAL_OP_PUT => LoggedOp::Put,
+                    cozorocks::WAL_OP_DELETE => LoggedOp::Delete,
+                    cozorocks::WAL_OP_MERGE => LoggedOp::Merge,
+                    _ => LoggedOp::DeleteRange,
+                };
+                ret.push(LoggedWrite {
+                    seq: entry.seq,
+                    op,
+                    key: entry.key,
+                    val: entry.value,
+                });
+            }
+        }
+        Ok(Some(ret))
+    }
+
+    fn storage_stats(&self) -> Result<Vec<(String, DataValue)>> {
+        let stats = self.db.cache_stats();
+        let mut ret = vec![
+            ("block_cache_capacity", stats.block_cache_capacity as u64),
+            ("block_cache_usage", stats.block_cache_usage as u64),
+            (
+                "block_cache_pinned_usage",
+                stats.block_cache_pinned_usage as u64,
+            ),
+            ("row_cache_capacity", stats.row_cache_capacity as u64),
+            ("row_cache_usage", stats.row_cache_usage as u64),
+        ];
+        let timings = self.db.open_timings();
+        ret.extend([
+            ("startup_load_options_micros", timings.load_options_micros),
+            ("startup_open_micros", timings.open_micros),
+            (
+                "startup_initialize_micros",
+                self.initialize_micros.load(Ordering::Relaxed),
+            ),
+            ("range_tombstones", self.db.range_tombstone_count()),
+            (
+                "removal_compactions_pending",
+                self.compactions
+                    .as_ref()
+                    .map(|c| c.pending.load(Ordering::Relaxed))
+                    .unwrap_or(0),
+            ),
+        ]);
+        if stats.statistics_enabled {
+            ret.extend([
+                ("block_cache_hit", stats.block_cache_hit),
+                ("block_cache_miss", stats.block_cache_miss),
+                ("block_cache_index_hit", stats.block_cache_index_hit),
+                ("block_cache_index_miss", stats.block_cache_index_miss),
+                ("block_cache_filter_hit", stats.block_cache_filter_hit),
+                ("block_cache_filter_miss", stats.block_cache_filter_miss),
+                ("block_cache_data_hit", stats.block_cache_data_hit),
+                ("block_cache_data_miss", stats.block_cache_data_miss),
+                ("row_cache_hit", stats.row_cache_hit),
+                ("row_cache_miss", stats.row_cache_miss),
+            ]);
+        }
+        Ok(ret
+            .into_iter()
+            .map(|(k, v)| (k.to_string(), DataValue::from(v as i64)))
+            .collect())
+    }
+
+    /// The counters are kept per thread by RocksDB, so work done by other threads,
+    /// such as parallel scans or background compactions, is not included.
+    fn start_perf_counters(&self) {
+        cozorocks::perf_start()
+    }
+
+    fn stop_perf_counters(&self) -> Vec<(String, DataValue)> {
+        let stats = cozorocks::perf_stop();
+        [
+            ("block_cache_hit_count", stats.block_cache_hit_count),
+            ("block_read_count", stats.block_read_count),
+            ("block_read_bytes", stats.block_read_byte),
+            ("bytes_read", stats.bytes_read),
+            ("get_from_memtable_count", stats.get_from_memtable_count),
+            ("seek_count", stats.seek_count),
+            ("next_count", stats.next_count),
+            ("bloom_sst_useful", stats.bloom_sst_useful),
+            ("bloom_sst_checked", stats.bloom_sst_checked),
+            (
+                "internal_key_skipped_count",
+                stats.internal_key_skipped_count,
+            ),
+            (
+                "internal_delete_skipped_count",
+                stats.internal_delete_skipped_count,
+            ),
+            (
+                "internal_range_del_reseek_count",
+                stats.internal_range_del_reseek_count,
+            ),
+        ]
+        .into_iter()
+        .map(|(k, v)| (k.to_string(), DataValue::from(v as i64)))
+        .collect()
+    }
+}
+
+enum RocksDbTxKind {
+    /// Read-only transactions read from a snapshot, without a transaction object or locking
+    Reader(DbSnapshot),
+    Writer(Tx),
 }
 
 pub struct RocksDbTx {
-    db_tx: Tx,
+    /// Declared first so that pooled iterators are dropped before the transaction
+    iter_pool: IterPool,
+    db_tx: RocksDbTxKind,
+    db: RocksDb,
+    options: Arc<RocksDbOptions>,
+    /// Relations whose column families are dropped once the transaction commits
+    dropped_cfs: Vec<u64>,
+    /// Relations whose column families were created by the transaction, dropped again
+    /// unless it commits
+    created_cfs: Vec<u64>,
+    /// Key ranges of relations without their own column family, dropped once the transaction commits
+    dropped_ranges: Vec<(Vec<u8>, Vec<u8>)>,
+    /// Key ranges where the transaction deleted many rows, compacted once it commits
+    purged_ranges: Vec<(Vec<u8>, Vec<u8>)>,
+    compactions: Option<CompactionScheduler>,
+    /// Retention settings of relations, applied once the transaction commits
+    retention_changes: Vec<(u64, Option<i64>)>,
 }
 
 unsafe impl Sync for RocksDbTx {}
 
+impl Drop for RocksDbTx {
+    fn drop(&mut self) {
+        for id in self.created_cfs.drain(..) {
+            if let Err(err) = self.db.drop_relation_cf(id) {
+                error!("cannot drop column family of uncommitted relation {id}: {err}");
+            }
+        }
+    }
+}
+
+/// Most idle iterators kept by a transaction.
+const ITER_POOL_MAX_IDLE: usize = 16;
+
+/// Iterators of a transaction kept for reuse by later scans of the same relation, so that
+/// nested-loop joins scanning a prefix per outer row do not create an iterator each time.
+///
+/// RocksDB reads the bounds of an iterator when it is created, so pooled iterators have none:
+/// a scan is ended by the key range passed along to [`DbIter::next_batch`] instead.
+#[derive(Default)]
+struct IterPool {
+    /// Idle iterators, with the relation they were created for and the write generation
+    /// at the time they were created
+    idle: Mutex<Vec<(Option<u64>, u64, DbIter)>>,
+    /// Bumped on every write of the transaction. Iterators of a transaction do not see writes
+    /// made after they were created, so idle ones of an earlier generation are discarded.
+    /// Read transactions never write, and keep their iterators.
+    generation: AtomicU64,
+}
+
+impl IterPool {
+    #[inline]
+    fn wrote(&self) {
+        self.generation.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+/// An iterator checked out from the pool of a transaction, returned to it when dropped.
+pub(crate) struct PooledIter<'a> {
+    pool: &'a IterPool,
+    relation: Option<u64>,
+    generation: u64,
+    inner: Option<DbIter>,
+}
+
+impl Deref for PooledIter<'_> {
+    type Target = DbIter;
+    fn deref(&self) -> &DbIter {
+        self.inner.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledIter<'_> {
+    fn deref_mut(&mut self) -> &mut DbIter {
+        self.inner.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledIter<'_> {
+    fn drop(&mut self) {
+        if let Some(it) = self.inner.take() {
+            let mut idle = self.pool.idle.lock().unwrap();
+            if idle.len() < ITER_POOL_MAX_IDLE {
+                idle.push((self.relation, self.generation, it));
+            }
+        }
+    }
+}
+
+/// Surfaces lock contention between pessimistic transactions as distinct, retryable errors.
+fn tx_error(err: RocksDbStatus) -> miette::Report {
+    if err.is_lock_timeout() {
+        LockTimeout(err.message).into()
+    } else if err.is_deadlock() {
+        Deadlock(err.message).into()
+    } else {
+        err.into()
+    }
+}
+
+/// The relation id `key` belongs to, or `None` for keys shorter than the id prefix.
+fn relation_id_of(key: &[u8]) -> Option<u64> {
+    key.get(..ENCODED_KEY_MIN_LEN)
+        .map(|prefix| u64::from_be_bytes(prefix.try_into().unwrap()))
+}
+
+impl RocksDbTx {
+    #[inline]
+    fn writer(&self) -> Result<&Tx> {
+        match &self.db_tx {
+            RocksDbTxKind::Reader(_) if self.db.is_read_only() => bail!(ReadOnlyStorage),
+            RocksDbTxKind::Reader(_) => bail!("write in read transaction"),
+            RocksDbTxKind::Writer(tx) => Ok(tx),
+        }
+    }
+
+    fn iterator(&self) -> IterBuilder {
+        match &self.db_tx {
+            RocksDbTxKind::Reader(snapshot) => snapshot.iterator(),
+            RocksDbTxKind::Writer(tx) => tx.iterator(),
+        }
+    }
+
+    fn iter_for(&self, lower: &[u8], upper: &[u8]) -> DbIter {
+        self.iterator().cf_of(lower).upper_bound(upper).start()
+    }
+
+    /// An unbounded iterator positioned at `lower`, reusing an idle one of the same relation
+    /// if there is any that has seen the latest writes of the transaction. Callers must stop
+    /// at the upper bound of their scan themselves.
+    fn pooled_iter_for(&self, lower: &[u8]) -> PooledIter<'_> {
+        let relation = relation_id_of(lower);
+        let generation = self.iter_pool.generation.load(Ordering::Relaxed);
+        let found = {
+            let mut idle = self.iter_pool.idle.lock().unwrap();
+            idle.retain(|(_, it_generation, _)| *it_generation == generation);
+            idle.iter()
+                .position(|(r, _, _)| *r == relation)
+                .map(|pos| idle.swap_remove(pos).2)
+        };
+        let mut it = found.unwrap_or_else(|| self.iterator().cf_of(lower).start());
+        it.seek(lower);
+        PooledIter {
+            pool: &self.iter_pool,
+            relation,
+            generation,
+            inner: Some(it),
+        }
+    }
+
+    /// Splits `[lower, upper)` at the boundaries of relations having their own column
+    /// families, since an iterator only ever sees a single column family.
+    fn scan_segments(&self, lower: &[u8], upper: &[u8]) -> Vec<(Vec<u8>, Vec<u8>)> {
+        if let Some(id) = relation_id_of(lower) {
+            if id == u64::MAX || upper <= &(id + 1).to_be_bytes()[..] {
+                return vec![(lower.to_vec(), upper.to_vec())];
+            }
+        }
+        let mut boundaries = vec![];
+        for id in self.db.relation_cf_ids() {
+            boundaries.push(id.to_be_bytes().to_vec());
+            if id != u64::MAX {
+                boundaries.push((id + 1).to_be_bytes().to_vec());
+            }
+        }
+        boundaries.retain(|b| lower < b.as_slice() && b.as_slice() < upper);
+        boundaries.sort();
+        boundaries.dedup();
+        let mut segments = vec![];
+        let mut start = lower.to_vec();
+        for b in boundaries {
+            segments.push((start, b.clone()));
+            start = b;
+        }
+        segments.push((start, upper.to_vec()));
+        segments
+    }
+}
+
 impl<'s> StoreTx<'s> for RocksDbTx {
     #[inline]
     fn get(&self, key: &[u8], for_update: bool) -> Result<Option<Vec<u8>>> {
-        Ok(self.db_tx.get(key, for_update)?.map(|v| v.to_vec()))
+        let found = match &self.db_tx {
+            RocksDbTxKind::Reader(snapshot) => snapshot.get(key)?,
+            RocksDbTxKind::Writer(tx) => tx.get(key, for_update).map_err(tx_error)?,
+        };
+        Ok(found.map(|v| v.to_vec()))
+    }
+
+    fn multi_get(&self, keys: &[Vec<u8>], for_update: bool) -> Result<Vec<Option<Vec<u8>>>> {
+        Ok(match &self.db_tx {
+            RocksDbTxKind::Reader(snapshot) => snapshot.multi_get(keys)?,
+            RocksDbTxKind::Writer(tx) => tx.multi_get(keys, for_update).map_err(tx_error)?,
+        })
     }
 
     #[inline]
     fn put(&mut self, key: &[u8], val: &[u8]) -> Result<()> {
-        Ok(self.db_tx.put(key, val)?)
+        self.iter_pool.wrote();
+        self.writer()?.put(key, val).map_err(tx_error)
     }
 
     fn supports_par_put(&self) -> bool {
@@ -173,56 +1199,171 @@ impl<'s> StoreTx<'s> for RocksDbTx {
 
     #[inline]
     fn par_put(&self, key: &[u8], val: &[u8]) -> Result<()> {
-        Ok(self.db_tx.put(key, val)?)
+        self.iter_pool.wrote();
+        self.writer()?.put(key, val).map_err(tx_error)
+    }
+
+    fn supports_merge(&self) -> bool {
+        true
+    }
+
+    #[inline]
+    fn merge(&mut self, key: &[u8], operand: &[u8]) -> Result<()> {
+        self.iter_pool.wrote();
+        self.writer()?.merge(key, operand).map_err(tx_error)
     }
 
     #[inline]
     fn del(&mut self, key: &[u8]) -> Result<()> {
-        Ok(self.db_tx.del(key)?)
+        self.iter_pool.wrote();
+        self.writer()?.del(key).map_err(tx_error)
     }
 
     #[inline]
     fn par_del(&self, key: &[u8]) -> Result<()> {
-        Ok(self.db_tx.del(key)?)
+        self.iter_pool.wrote();
+        self.writer()?.del(key).map_err(tx_error)
     }
 
     fn del_range_from_persisted(&mut self, lower: &[u8], upper: &[u8]) -> Result<()> {
-        let mut inner = self.db_tx.iterator().upper_bound(upper).start();
-        inner.seek(lower);
-        while let Some(key) = inner.key()? {
-            if key >= upper {
-                break;
+        self.writer()?;
+        let mut whole_relation = false;
+        if let (Some(id), Some(next_id)) = (relation_id_of(lower), relation_id_of(upper)) {
+            if lower.len() == ENCODED_KEY_MIN_LEN
+                && upper.len() == ENCODED_KEY_MIN_LEN
+                && id.checked_add(1) == Some(next_id)
+            {
+                // Relation ids are never reused, so nothing reads the column family again
+                if self.db.relation_cf_ids().contains(&id) {
+                    self.dropped_cfs.push(id);
+                    return Ok(());
+                }
+                // The rows are still deleted below, as scans of the whole store ignore range
+                // tombstones and the drop after commit may never happen if the process dies.
+                // The drop then only reclaims the files of the range early.
+                whole_relation = true;
+                self.dropped_ranges.push((lower.to_vec(), upper.to_vec()));
             }
-            self.db_tx.del(key)?;
-            inner.next();
+        }
+        // Within a transaction, rows are deleted one by one: reads ignore range tombstones,
+        // which are only written over ranges whose rows are already deleted
+        let tx = self.writer()?;
+        self.iter_pool.wrote();
+        let mut n_deleted = 0;
+        for (seg_lower, seg_upper) in self.scan_segments(lower, upper) {
+            let mut inner = self.iter_for(&seg_lower, &seg_upper);
+            inner.seek(&seg_lower);
+            while let Some(key) = inner.key()? {
+                if key >= seg_upper.as_slice() {
+                    break;
+                }
+                tx.del(key).map_err(tx_error)?;
+                n_deleted += 1;
+                inner.next();
+            }
+        }
+        if !whole_relation && n_deleted >= REMOVAL_COMPACTION_MIN_ROWS {
+            self.purged_ranges.push((lower.to_vec(), upper.to_vec()));
         }
         Ok(())
     }
 
+    /// Column families are created right away, since the rows written by the transaction
+    /// are routed to them. They are dropped again if the transaction does not commit, and
+    /// when opening the database if the process died before that.
+    fn relation_created(&mut self, id: u64, name: &str) -> Result<()> {
+        if self.options.relation_column_families {
+            self.db
+                .create_relation_cf(id, &self.options.cf_opts_for(name))?;
+            self.created_cfs.push(id);
+        }
+        Ok(())
+    }
+
+    fn relations_loaded(&mut self, ids: &BTreeSet<u64>) -> Result<()> {
+        for id in self.db.relation_cf_ids() {
+            if !ids.contains(&id) {
+                warn!("dropping column family of relation {id}, whose creation never committed");
+                self.dropped_cfs.push(id);
+            }
+        }
+        Ok(())
+    }
+
+    fn set_relation_retention(&mut self, id: u64, retention_micros: Option<i64>) -> Result<()> {
+        self.retention_changes.push((id, retention_micros));
+        Ok(())
+    }
+
     #[inline]
     fn exists(&self, key: &[u8], for_update: bool) -> Result<bool> {
-        Ok(self.db_tx.exists(key, for_update)?)
+        Ok(match &self.db_tx {
+            RocksDbTxKind::Reader(snapshot) => snapshot.exists(key)?,
+            RocksDbTxKind::Writer(tx) => tx.exists(key, for_update).map_err(tx_error)?,
+        })
+    }
+
+    fn multi_exists(&self, keys: &[Vec<u8>], for_update: bool) -> Result<Vec<bool>> {
+        Ok(match &self.db_tx {
+            RocksDbTxKind::Reader(snapshot) => snapshot.multi_exists(keys)?,
+            RocksDbTxKind::Writer(tx) => tx.multi_exists(keys, for_update).map_err(tx_error)?,
+        })
     }
 
     fn commit(&mut self) -> Result<()> {
-        Ok(self.db_tx.commit()?)
+        let tx = match &mut self.db_tx {
+            RocksDbTxKind::Reader(_) => return Ok(()),
+            RocksDbTxKind::Writer(tx) => tx,
+        };
+        self.iter_pool.idle.get_mut().unwrap().clear();
+        match tx.commit() {
+            Ok(()) => {}
+            Err(err) if err.is_conflict() => bail!(TransactionConflict(err.message)),
+            Err(err) => return Err(err.into()),
+        }
+        self.created_cfs.clear();
+        // The removal is committed at this point, so a failed drop only leaves unreachable data behind
+        for id in self.dropped_cfs.drain(..) {
+            if let Err(err) = self.db.drop_relation_cf(id) {
+                error!("cannot drop column family of relation {id}: {err}");
+            }
+        }
+        for (lower, upper) in self.dropped_ranges.drain(..) {
+            if let Err(err) = self.db.range_drop(&lower, &upper) {
+                error!("cannot drop range of destroyed relation: {err}");
+            }
+            // Files only partly within the range keep its rows and the tombstone until compacted
+            if let Some(compactions) = &self.compactions {
+                compactions.schedule(lower, upper);
+            }
+        }
+        for (lower, upper) in self.purged_ranges.drain(..) {
+            if let Some(compactions) = &self.compactions {
+                compactions.schedule(lower, upper);
+            }
+        }
+        for (id, retention_micros) in self.retention_changes.drain(..) {
+            self.db.set_relation_retention(id, retention_micros);
+        }
+        Ok(())
     }
 
     fn range_scan_tuple<'a>(
         &'a self,
         lower: &[u8],
         upper: &[u8],
-    ) -> Box<dyn Iterator<Item = Result<Tuple>>>
+    ) -> Box<dyn Iterator<Item = Result<Tuple>> + 'a>
     where
         's: 'a,
     {
-        let mut inner = self.db_tx.iterator().upper_bound(upper).start();
-        inner.seek(lower);
-        Box::new(RocksDbIterator {
-            inner,
-            started: false,
-            upper_bound: upper.to_vec(),
-        })
+        let segments = self.scan_segments(lower, upper);
+        Box::new(segments.into_iter().flat_map(move |(lower, upper)| {
+            let inner = self.pooled_iter_for(&lower);
+            RocksDbIterator {
+                inner: BatchedRows::new(inner, upper.clone()),
+                upper_bound: upper,
+            }
+        }))
     }
 
     fn range_skip_scan_tuple<'a>(
@@ -231,7 +1372,7 @@ impl<'s> StoreTx<'s> for RocksDbTx {
         upper: &[u8],
         valid_at: ValidityTs,
     ) -> Box<dyn Iterator<Item = Result<Tuple>> + 'a> {
-        let inner = self.db_tx.iterator().upper_bound(upper).start();
+        let inner = self.pooled_iter_for(lower);
         Box::new(RocksDbSkipIterator {
             inner,
             upper_bound: upper.to_vec(),
@@ -244,36 +1385,65 @@ impl<'s> StoreTx<'s> for RocksDbTx {
         &'a self,
         lower: &[u8],
         upper: &[u8],
-    ) -> Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>>>
+    ) -> Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>> + 'a>
     where
         's: 'a,
     {
-        let mut inner = self.db_tx.iterator().upper_bound(upper).start();
-        inner.seek(lower);
-        Box::new(RocksDbIteratorRaw {
-            inner,
-            started: false,
-            upper_bound: upper.to_vec(),
-        })
+        let segments = self.scan_segments(lower, upper);
+        Box::new(segments.into_iter().flat_map(move |(lower, upper)| {
+            let inner = self.pooled_iter_for(&lower);
+            RocksDbIteratorRaw {
+                inner: BatchedRows::new(inner, upper.clone()),
+                upper_bound: upper,
+            }
+        }))
     }
 
     fn range_count<'a>(&'a self, lower: &[u8], upper: &[u8]) -> Result<usize>
     where
         's: 'a,
     {
-        let mut inner = self.db_tx.iterator().upper_bound(upper).start();
-        inner.seek(lower);
         let mut count = 0;
-        while let Some(k) = inner.key()? {
-            if k >= upper {
-                break;
+        for (lower, upper) in self.scan_segments(lower, upper) {
+            let mut inner = self.pooled_iter_for(&lower);
+            while let Some(k) = inner.key()? {
+                if k >= upper.as_slice() {
+                    break;
+                }
+                count += 1;
+                inner.next();
             }
-            count += 1;
-            inner.next();
         }
         Ok(count)
     }
 
+    /// Uses RocksDB's approximations of SST file and memtable sizes, without reading any key.
+    /// Writes of this transaction that are not yet committed are not taken into account.
+    fn range_count_estimate(&self, lower: &[u8], upper: &[u8]) -> Result<Option<usize>> {
+        let mut total = 0;
+        for (lower, upper) in self.scan_segments(lower, upper) {
+            total += self
+                .db
+                .approximate_range_stats(&lower, &upper)
+                .estimated_keys();
+        }
+        Ok(Some(total as usize))
+    }
+
+    fn relation_stats(&self, relation_id: u64) -> Result<Option<RelationStats>> {
+        let stats = self
+            .db
+            .relation_table_stats(relation_id)
+            .into_diagnostic()?;
+        Ok(Some(RelationStats {
+            num_files: stats.num_files as usize,
+            num_rows: stats.num_rows as usize,
+            key_bytes: stats.key_bytes as usize,
+            value_bytes: stats.value_bytes as usize,
+            distinct_first_keys: stats.distinct_first_keys as usize,
+        }))
+    }
+
     fn total_scan<'a>(&'a self) -> Box<dyn Iterator<Item = Result<(Vec<u8>, Vec<u8>)>> + 'a>
     where
         's: 'a,
@@ -282,21 +1452,69 @@ impl<'s> StoreTx<'s> for RocksDbTx {
     }
 }
 
-pub(crate) struct RocksDbIterator {
-    inner: DbIter,
-    started: bool,
+/// Initial number of rows fetched per batch by scans. Grows on each refill
+/// so that short prefix scans do not read far beyond what they need.
+const SCAN_BATCH_MIN_ROWS: usize = 8;
+const SCAN_BATCH_MAX_ROWS: usize = 1024;
+const SCAN_BATCH_MAX_BYTES: usize = 1 << 20;
+
+/// Reads rows from a positioned iterator in batches, so that each batch crosses
+/// the FFI boundary once and lands in a single buffer.
+pub(crate) struct BatchedRows<'a> {
+    inner: PooledIter<'a>,
+    /// Exclusive upper bound of the scan, past which no row is fetched
+    end: Vec<u8>,
+    batch: RowBatch,
+    pos: usize,
+    batch_rows: usize,
+    exhausted: bool,
+}
+
+impl<'a> BatchedRows<'a> {
+    fn new(inner: PooledIter<'a>, end: Vec<u8>) -> Self {
+        Self {
+            inner,
+            end,
+            batch: RowBatch::default(),
+            pos: 0,
+            batch_rows: SCAN_BATCH_MIN_ROWS,
+            exhausted: false,
+        }
+    }
+    #[inline]
+    fn next_pair(&mut self) -> Result<Option<(&[u8], &[u8])>> {
+        if self.pos >= self.batch.len() {
+            if self.exhausted {
+                return Ok(None);
+            }
+            let n = self.inner.next_batch(
+                self.batch_rows,
+                SCAN_BATCH_MAX_BYTES,
+                &self.end,
+                &mut self.batch,
+            )?;
+            self.batch_rows = (self.batch_rows * 2).min(SCAN_BATCH_MAX_ROWS);
+            self.pos = 0;
+            if n == 0 {
+                self.exhausted = true;
+                return Ok(None);
+            }
+        }
+        let pair = self.batch.get(self.pos);
+        self.pos += 1;
+        Ok(Some(pair))
+    }
+}
+
+pub(crate) struct RocksDbIterator<'a> {
+    inner: BatchedRows<'a>,
     upper_bound: Vec<u8>,
 }
 
-impl RocksDbIterator {
+impl RocksDbIterator<'_> {
     #[inline]
     fn next_inner(&mut self) -> Result<Option<Tuple>> {
-        if self.started {
-            self.inner.next()
-        } else {
-            self.started = true;
-        }
-        Ok(match self.inner.pair()? {
+        Ok(match self.inner.next_pair()? {
             None => None,
             Some((k_slice, v_slice)) => {
                 if self.upper_bound.as_slice() <= k_slice {
@@ -310,7 +1528,7 @@ impl RocksDbIterator {
     }
 }
 
-impl Iterator for RocksDbIterator {
+impl Iterator for RocksDbIterator<'_> {
     type Item = Result<Tuple>;
     #[inline]
     fn next(&mut self) -> Option<Self::Item> {
@@ -318,14 +1536,14 @@ impl Iterator for RocksDbIterator {
     }
 }
 
-pub(crate) struct RocksDbSkipIterator {
-    inner: DbIter,
+pub(crate) struct RocksDbSkipIterator<'a> {
+    inner: PooledIter<'a>,
     upper_bound: Vec<u8>,
     next_bound: Vec<u8>,
     valid_at: ValidityTs,
 }
 
-impl RocksDbSkipIterator {
+impl RocksDbSkipIterator<'_> {
     #[inline]
     fn next_inner(&mut self) -> Result<Option<Tuple>> {
         loop {
@@ -349,7 +1567,7 @@ impl RocksDbSkipIterator {
     }
 }
 
-impl Iterator for RocksDbSkipIterator {
+impl Iterator for RocksDbSkipIterator<'_> {
     type Item = Result<Tuple>;
     #[inline]
     fn next(&mut self) -> Option<Self::Item> {
@@ -357,21 +1575,15 @@ impl Iterator for RocksDbSkipIterator {
     }
 }
 
-pub(crate) struct RocksDbIteratorRaw {
-    inner: DbIter,
-    started: bool,
+pub(crate) struct RocksDbIteratorRaw<'a> {
+    inner: BatchedRows<'a>,
     upper_bound: Vec<u8>,
 }
 
-impl RocksDbIteratorRaw {
+impl RocksDbIteratorRaw<'_> {
     #[inline]
     fn next_inner(&mut self) -> Result<Option<(Vec<u8>, Vec<u8>)>> {
-        if self.started {
-            self.inner.next()
-        } else {
-            self.started = true;
-        }
-        Ok(match self.inner.pair()? {
+        Ok(match self.inner.next_pair()? {
             None => None,
             Some((k_slice, v_slice)) => {
                 if self.upper_bound.as_slice() <= k_slice {
@@ -385,10 +1597,40 @@ impl RocksDbIteratorRaw {
     }
 }
 
-impl Iterator for RocksDbIteratorRaw {
+impl Iterator for RocksDbIteratorRaw<'_> {
     type Item = Result<(Vec<u8>, Vec<u8>)>;
     #[inline]
     fn next(&mut self) -> Option<Self::Item> {
         swap_option_result(self.next_inner())
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn range(lower: &[u8], upper: &[u8]) -> (Vec<u8>, Vec<u8>) {
+        (lower.to_vec(), upper.to_vec())
+    }
+
+    #[test]
+    fn coalesce_ranges_merges_overlapping_and_touching() {
+        assert_eq!(coalesce_ranges(vec![]), vec![]);
+        let ranges = vec![
+            range(b"\x05", b"\x06"),
+            range(b"\x01", b"\x02"),
+            range(b"\x02", b"\x03"),
+            range(b"\x08", b"\x0a"),
+            range(b"\x09", b"\x09\xff"),
+            range(b"\x05\x00", b"\x05\x01"),
+        ];
+        assert_eq!(
+            coalesce_ranges(ranges),
+            vec![
+                range(b"\x01", b"\x03"),
+                range(b"\x05", b"\x06"),
+                range(b"\x08", b"\x0a"),
+            ]
+        );
+    }
+}
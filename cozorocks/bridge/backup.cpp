@@ -0,0 +1,95 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "backup.h"
+#include "cozorocks/src/bridge/mod.rs.h"
+#include "rocksdb/rate_limiter.h"
+
+static BackupEngineOptions backup_engine_options(const BackupOpts &opts) {
+    BackupEngineOptions options{string(opts.backup_dir)};
+    options.share_table_files = true;
+    options.share_files_with_checksum = true;
+    if (opts.threads > 0) {
+        options.max_background_operations = opts.threads;
+    }
+    if (opts.rate_limit > 0) {
+        options.backup_rate_limiter.reset(NewGenericRateLimiter(static_cast<int64_t>(opts.rate_limit)));
+        options.restore_rate_limiter.reset(NewGenericRateLimiter(static_cast<int64_t>(opts.rate_limit)));
+    }
+    return options;
+}
+
+uint32_t create_backup(const RocksDbBridge &db, const BackupOpts &opts, RocksDbStatus &status) {
+    BackupEngine *engine_ptr = nullptr;
+    auto s = BackupEngine::Open(backup_engine_options(opts), Env::Default(), &engine_ptr);
+    if (!s.ok()) {
+        write_status(s, status);
+        return 0;
+    }
+    unique_ptr<BackupEngine> engine(engine_ptr);
+    CreateBackupOptions create_options;
+    create_options.flush_before_backup = true;
+    BackupID backup_id = 0;
+    s = engine->CreateNewBackup(create_options, db.get_db(), &backup_id);
+    if (s.ok() && opts.num_to_keep > 0) {
+        s = engine->PurgeOldBackups(opts.num_to_keep);
+    }
+    if (s.ok() && opts.verify) {
+        s = engine->VerifyBackup(backup_id, opts.verify_checksums);
+    }
+    write_status(s, status);
+    return backup_id;
+}
+
+void list_backups(const BackupOpts &opts, rust::Vec<BackupEntry> &entries, RocksDbStatus &status) {
+    BackupEngineReadOnly *engine_ptr = nullptr;
+    auto s = BackupEngineReadOnly::Open(backup_engine_options(opts), Env::Default(), &engine_ptr);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    unique_ptr<BackupEngineReadOnly> engine(engine_ptr);
+    vector<BackupInfo> infos;
+    engine->GetBackupInfo(&infos);
+    for (auto &info: infos) {
+        BackupEntry entry;
+        entry.backup_id = info.backup_id;
+        entry.timestamp = info.timestamp;
+        entry.size = info.size;
+        entry.number_files = info.number_files;
+        entries.push_back(entry);
+    }
+    write_status(Status::OK(), status);
+}
+
+void verify_backup(const BackupOpts &opts, uint32_t backup_id, RocksDbStatus &status) {
+    BackupEngineReadOnly *engine_ptr = nullptr;
+    auto s = BackupEngineReadOnly::Open(backup_engine_options(opts), Env::Default(), &engine_ptr);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    unique_ptr<BackupEngineReadOnly> engine(engine_ptr);
+    write_status(engine->VerifyBackup(backup_id, opts.verify_checksums), status);
+}
+
+void restore_backup(const BackupOpts &opts, uint32_t backup_id, rust::Str db_dir, RocksDbStatus &status) {
+    BackupEngineReadOnly *engine_ptr = nullptr;
+    auto s = BackupEngineReadOnly::Open(backup_engine_options(opts), Env::Default(), &engine_ptr);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    unique_ptr<BackupEngineReadOnly> engine(engine_ptr);
+    string dir(db_dir);
+    RestoreOptions restore_options;
+    if (backup_id == 0) {
+        s = engine->RestoreDBFromLatestBackup(restore_options, dir, dir);
+    } else {
+        s = engine->RestoreDBFromBackup(restore_options, backup_id, dir, dir);
+    }
+    write_status(s, status);
+}
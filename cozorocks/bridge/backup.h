@@ -0,0 +1,32 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_BACKUP_H
+#define COZOROCKS_BACKUP_H
+
+#include "common.h"
+#include "db.h"
+#include "rocksdb/utilities/backup_engine.h"
+
+// Backups taken with the RocksDB backup engine. All backups in a directory share the SST files they
+// have in common, so that each new backup only copies the files written since the previous one.
+
+// Takes a new backup of `db`, after flushing its memtables, and returns its id. Older backups beyond
+// `opts.num_to_keep` are then purged, and the new backup is verified if `opts.verify` is set.
+uint32_t create_backup(const RocksDbBridge &db, const BackupOpts &opts, RocksDbStatus &status);
+
+// Appends the backups in `opts.backup_dir` to `entries`, oldest first.
+void list_backups(const BackupOpts &opts, rust::Vec<BackupEntry> &entries, RocksDbStatus &status);
+
+// Checks that the files of a backup exist with the recorded sizes, and their checksums
+// if `opts.verify_checksums` is set.
+void verify_backup(const BackupOpts &opts, uint32_t backup_id, RocksDbStatus &status);
+
+// Restores a backup, or the latest one if `backup_id` is 0, into `db_dir`, replacing the files there.
+// The database must not be open.
+void restore_backup(const BackupOpts &opts, uint32_t backup_id, rust::Str db_dir, RocksDbStatus &status);
+
+#endif //COZOROCKS_BACKUP_H
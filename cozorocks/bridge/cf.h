@@ -0,0 +1,132 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_CF_H
+#define COZOROCKS_CF_H
+
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <shared_mutex>
+#include <mutex>
+
+#include "common.h"
+
+static const size_t RELATION_PREFIX_LEN = 8;
+static const char RELATION_CF_PREFIX[] = "relation_";
+
+inline uint64_t decode_relation_prefix(const Slice &key) {
+    uint64_t id = 0;
+    for (size_t i = 0; i < RELATION_PREFIX_LEN; ++i) {
+        id = (id << 8) | static_cast<uint8_t>(key[i]);
+    }
+    return id;
+}
+
+inline string relation_cf_name(uint64_t id) {
+    return RELATION_CF_PREFIX + to_string(id);
+}
+
+// Parses a column family name created by `relation_cf_name`, returning false for any other name.
+inline bool parse_relation_cf_name(const string &name, uint64_t &id) {
+    auto prefix_len = strlen(RELATION_CF_PREFIX);
+    if (name.size() <= prefix_len || name.compare(0, prefix_len, RELATION_CF_PREFIX) != 0) {
+        return false;
+    }
+    try {
+        size_t pos = 0;
+        id = stoull(name.substr(prefix_len), &pos);
+        return pos == name.size() - prefix_len;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Maps relation ids to the column families holding them. Every key starts with the 8-byte
+// big-endian id of its relation; keys of relations without their own column family live in the
+// default one. Handles of dropped column families are retired rather than destroyed until the
+// database closes, since transactions and iterators started before the drop may still hold them.
+struct CfRegistry {
+    ColumnFamilyHandle *default_cf;
+    map<uint64_t, ColumnFamilyHandle *> by_id;
+    vector<ColumnFamilyHandle *> retired;
+    mutable shared_mutex mutex;
+    // Size of `by_id`, so that lookups skip the lock when no relation has its own column family
+    atomic<size_t> n_relation_cfs;
+
+    explicit CfRegistry(ColumnFamilyHandle *default_cf_) : default_cf(default_cf_), n_relation_cfs(0) {}
+
+    inline ColumnFamilyHandle *for_id(uint64_t id) const {
+        if (n_relation_cfs.load(std::memory_order_acquire) == 0) {
+            return default_cf;
+        }
+        shared_lock lock(mutex);
+        auto it = by_id.find(id);
+        return it == by_id.end() ? default_cf : it->second;
+    }
+
+    inline ColumnFamilyHandle *for_key(const Slice &key) const {
+        if (key.size() < RELATION_PREFIX_LEN || n_relation_cfs.load(std::memory_order_acquire) == 0) {
+            return default_cf;
+        }
+        shared_lock lock(mutex);
+        auto it = by_id.find(decode_relation_prefix(key));
+        return it == by_id.end() ? default_cf : it->second;
+    }
+
+    inline bool contains(uint64_t id) const {
+        shared_lock lock(mutex);
+        return by_id.find(id) != by_id.end();
+    }
+
+    inline void add(uint64_t id, ColumnFamilyHandle *handle) {
+        unique_lock lock(mutex);
+        by_id[id] = handle;
+        n_relation_cfs.store(by_id.size(), std::memory_order_release);
+    }
+
+    // Unregisters the column family of `id`, returning its handle, or nullptr if there is none.
+    inline ColumnFamilyHandle *remove(uint64_t id) {
+        unique_lock lock(mutex);
+        auto it = by_id.find(id);
+        if (it == by_id.end()) {
+            return nullptr;
+        }
+        auto handle = it->second;
+        by_id.erase(it);
+        n_relation_cfs.store(by_id.size(), std::memory_order_release);
+        retired.push_back(handle);
+        return handle;
+    }
+
+    // Keeps a handle that is not routed to, such as one for a column family not created by us.
+    inline void retire(ColumnFamilyHandle *handle) {
+        unique_lock lock(mutex);
+        retired.push_back(handle);
+    }
+
+    inline vector<uint64_t> ids() const {
+        shared_lock lock(mutex);
+        vector<uint64_t> ret;
+        ret.reserve(by_id.size());
+        for (auto &pair: by_id) {
+            ret.push_back(pair.first);
+        }
+        return ret;
+    }
+
+    // All handles other than the default one, including retired ones, for destruction on close.
+    inline vector<ColumnFamilyHandle *> all_handles() const {
+        shared_lock lock(mutex);
+        vector<ColumnFamilyHandle *> ret(retired);
+        for (auto &pair: by_id) {
+            ret.push_back(pair.second);
+        }
+        return ret;
+    }
+};
+
+#endif //COZOROCKS_CF_H
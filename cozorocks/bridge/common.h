@@ -17,12 +17,32 @@
 #include "rocksdb/table.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/slice_transform.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/statistics.h"
+#include "rocksdb/compaction_filter.h"
+#include "rocksdb/merge_operator.h"
+#include "rocksdb/perf_context.h"
+#include "rocksdb/perf_level.h"
+#include "rocksdb/iostats_context.h"
+#include "rocksdb/table_properties.h"
+#include "rocksdb/write_buffer_manager.h"
+#include "rocksdb/sst_partitioner.h"
+#include "rocksdb/listener.h"
 
 using namespace rocksdb;
 using namespace std;
 
 struct RocksDbStatus;
 struct DbOpts;
+struct CacheStats;
+struct OpenTimings;
+struct BackupOpts;
+struct BackupEntry;
+struct WalEntry;
+struct CfOpts;
+struct PerfStats;
+struct RangeStats;
+struct RelationTableStats;
 
 typedef Status::Code StatusCode;
 typedef Status::SubCode StatusSubCode;
@@ -4,11 +4,13 @@
 // If a copy of the MPL was not distributed with this file,
 // You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include "db.h"
 #include "cozorocks/src/bridge/mod.rs.h"
 #include "rocksdb/utilities/options_util.h"
+#include "rocksdb/utilities/checkpoint.h"
 
 Options default_db_options() {
     Options options = Options();
@@ -26,6 +28,7 @@ Options default_db_options() {
 
     auto table_factory = NewBlockBasedTableFactory(table_options);
     options.table_factory.reset(table_factory);
+    options.table_properties_collector_factories.emplace_back(make_shared<RelationStatsCollectorFactory>());
 
     return options;
 }
@@ -49,17 +52,36 @@ ColumnFamilyOptions default_cf_options() {
 
     auto table_factory = NewBlockBasedTableFactory(table_options);
     options.table_factory.reset(table_factory);
+    options.table_properties_collector_factories.emplace_back(make_shared<RelationStatsCollectorFactory>());
 
     return options;
 }
 
+const FilterPolicy *new_filter_policy(double bits_per_key, bool ribbon) {
+    if (ribbon) {
+        return NewRibbonFilterPolicy(bits_per_key);
+    }
+    return NewBloomFilterPolicy(bits_per_key, false);
+}
+
+static uint64_t micros_since(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+}
+
 shared_ptr <RocksDbBridge> open_db(const DbOpts &opts, RocksDbStatus &status) {
+    auto load_options_start = chrono::steady_clock::now();
+    uint64_t load_options_micros = 0;
     auto options = default_db_options();
 
     shared_ptr<Cache> cache = nullptr;
 
     if (opts.block_cache_size > 0) {
-        cache = NewLRUCache(1 * 1024 * 1024 * 1024);
+        if (opts.use_hyper_clock_cache) {
+            HyperClockCacheOptions cache_opts(opts.block_cache_size, 16 * 1024);
+            cache = cache_opts.MakeSharedCache();
+        } else {
+            cache = NewLRUCache(opts.block_cache_size);
+        }
     }
 
     if (!opts.options_path.empty()) {
@@ -74,17 +96,10 @@ shared_ptr <RocksDbBridge> open_db(const DbOpts &opts, RocksDbStatus &status) {
             return nullptr;
         }
 
-        if (cache != nullptr) {
-            for (size_t i = 0; i < loaded_cf_descs.size(); ++i) {
-                auto* loaded_bbt_opt =
-                        loaded_cf_descs[0]
-                                .options.table_factory->GetOptions<BlockBasedTableOptions>();
-                loaded_bbt_opt->block_cache = cache;
-            }
-        }
-
         options = Options(loaded_db_opt, loaded_cf_descs[0].options);
+        ensure_relation_stats_collector(options);
     }
+    load_options_micros += micros_since(load_options_start);
 
     if (opts.prepare_for_bulk_load) {
         options.PrepareForBulkLoad();
@@ -96,6 +111,17 @@ shared_ptr <RocksDbBridge> open_db(const DbOpts &opts, RocksDbStatus &status) {
         options.OptimizeLevelStyleCompaction();
     }
     options.create_if_missing = opts.create_if_missing;
+    if (opts.max_file_opening_threads > 0) {
+        options.max_file_opening_threads = opts.max_file_opening_threads;
+    }
+    options.skip_stats_update_on_db_open = opts.skip_stats_update_on_db_open;
+    if (opts.wal_ttl_seconds > 0) {
+        options.WAL_ttl_seconds = opts.wal_ttl_seconds;
+    }
+    if (opts.wal_size_limit_mb > 0) {
+        options.WAL_size_limit_MB = opts.wal_size_limit_mb;
+    }
+    options.skip_checking_sst_file_sizes_on_db_open = opts.skip_checking_sst_file_sizes_on_db_open;
     options.paranoid_checks = opts.paranoid_checks;
     if (opts.enable_blob_files) {
         options.enable_blob_files = true;
@@ -106,11 +132,47 @@ shared_ptr <RocksDbBridge> open_db(const DbOpts &opts, RocksDbStatus &status) {
 
         options.enable_blob_garbage_collection = opts.enable_blob_garbage_collection;
     }
-    if (opts.use_bloom_filter) {
-        BlockBasedTableOptions table_options;
-        table_options.filter_policy.reset(NewBloomFilterPolicy(opts.bloom_filter_bits_per_key, false));
-        table_options.whole_key_filtering = opts.bloom_filter_whole_key_filtering;
-        options.table_factory.reset(NewBlockBasedTableFactory(table_options));
+    // Amend the table options in place, so that settings from the defaults or the options file are kept
+    auto *table_options = options.table_factory->GetOptions<BlockBasedTableOptions>();
+    if (table_options != nullptr) {
+        if (cache != nullptr) {
+            table_options->block_cache = cache;
+        }
+        if (opts.use_bloom_filter) {
+            table_options->filter_policy.reset(new_filter_policy(opts.bloom_filter_bits_per_key, opts.use_ribbon_filter));
+            table_options->whole_key_filtering = opts.bloom_filter_whole_key_filtering;
+        }
+        if (opts.partition_index_filters) {
+            table_options->index_type = BlockBasedTableOptions::kTwoLevelIndexSearch;
+            table_options->partition_filters = table_options->filter_policy != nullptr;
+            table_options->metadata_block_size = 4096;
+            table_options->cache_index_and_filter_blocks = true;
+            table_options->cache_index_and_filter_blocks_with_high_priority = true;
+            table_options->pin_top_level_index_and_filter = true;
+        }
+        table_options->optimize_filters_for_memory = opts.optimize_filters_for_memory;
+    }
+    options.enable_pipelined_write = opts.enable_pipelined_write;
+    options.allow_concurrent_memtable_write = opts.allow_concurrent_memtable_write;
+    if (opts.unordered_write) {
+        options.unordered_write = true;
+        // Recommended with unordered writes, so that commits need not wait for the memtable
+        options.two_write_queues = true;
+    }
+    if (opts.write_buffer_size > 0) {
+        options.write_buffer_size = opts.write_buffer_size;
+    }
+    if (opts.max_write_buffer_number > 0) {
+        options.max_write_buffer_number = static_cast<int>(opts.max_write_buffer_number);
+    }
+    if (opts.write_buffer_manager_size > 0) {
+        options.write_buffer_manager = make_shared<WriteBufferManager>(opts.write_buffer_manager_size);
+    }
+    if (opts.row_cache_size > 0) {
+        options.row_cache = NewLRUCache(opts.row_cache_size);
+    }
+    if (opts.enable_statistics) {
+        options.statistics = CreateDBStatistics();
     }
     if (opts.use_capped_prefix_extractor) {
         options.prefix_extractor.reset(NewCappedPrefixTransform(opts.capped_prefix_extractor_len));
@@ -122,27 +184,516 @@ shared_ptr <RocksDbBridge> open_db(const DbOpts &opts, RocksDbStatus &status) {
 
     shared_ptr <RocksDbBridge> db = make_shared<RocksDbBridge>();
 
+    db->retention = make_shared<RetentionRegistry>();
+    db->range_tombstones = make_shared<RangeTombstoneCounter>();
+    options.listeners.emplace_back(db->range_tombstones);
+    db->use_ribbon_filter = opts.use_ribbon_filter;
+    options.compaction_filter_factory = make_shared<VersionGcFilterFactory>(db->retention);
+    options.merge_operator = make_shared<CozoMergeOperator>();
+    if (opts.sst_partition_prefix_len > 0) {
+        options.sst_partitioner_factory = make_shared<PrefixSstPartitionerFactory>(opts.sst_partition_prefix_len);
+    }
+
     db->db_path = convert_vec_to_string(opts.db_path);
+    if (table_options != nullptr) {
+        db->block_cache = table_options->block_cache;
+    }
+    db->row_cache = options.row_cache;
+    db->statistics = options.statistics;
+
+    db->relation_cf_options = ColumnFamilyOptions(options);
+
+    // Every existing column family must be opened. Those created for relations are reopened with
+    // the options RocksDB persisted for them, sharing the block cache of the default column family.
+    load_options_start = chrono::steady_clock::now();
+    vector<ColumnFamilyDescriptor> cf_descs;
+    cf_descs.emplace_back(kDefaultColumnFamilyName, ColumnFamilyOptions(options));
+    vector<string> cf_names;
+    if (DB::ListColumnFamilies(options, db->db_path, &cf_names).ok() && cf_names.size() > 1) {
+        DBOptions latest_db_opts;
+        vector<ColumnFamilyDescriptor> latest_cf_descs;
+        ConfigOptions config_options;
+        config_options.ignore_unknown_options = true;
+        auto s = LoadLatestOptions(config_options, db->db_path, &latest_db_opts, &latest_cf_descs);
+        for (auto &name: cf_names) {
+            if (name == kDefaultColumnFamilyName) {
+                continue;
+            }
+            ColumnFamilyOptions cf_opts = db->relation_cf_options;
+            if (s.ok()) {
+                for (auto &desc: latest_cf_descs) {
+                    if (desc.name == name) {
+                        cf_opts = desc.options;
+                        cf_opts.compaction_filter_factory = options.compaction_filter_factory;
+                        cf_opts.merge_operator = options.merge_operator;
+                        ensure_relation_stats_collector(cf_opts);
+                        cf_opts.sst_partitioner_factory = options.sst_partitioner_factory;
+                        auto *cf_table_options = cf_opts.table_factory->GetOptions<BlockBasedTableOptions>();
+                        if (cf_table_options != nullptr && table_options != nullptr) {
+                            cf_table_options->block_cache = table_options->block_cache;
+                        }
+                        break;
+                    }
+                }
+            }
+            cf_descs.emplace_back(name, cf_opts);
+        }
+    }
+    db->load_options_micros = load_options_micros + micros_since(load_options_start);
 
-    TransactionDB *txn_db = nullptr;
-    write_status(
-            TransactionDB::Open(options, TransactionDBOptions(), db->db_path, &txn_db),
-            status);
-    db->db.reset(txn_db);
+    auto open_start = chrono::steady_clock::now();
+    DB *txn_db = nullptr;
+    vector<ColumnFamilyHandle *> handles;
+    if (!opts.secondary_path.empty()) {
+        // A secondary instance must keep every file it has opened open, as the primary may delete them
+        options.max_open_files = -1;
+        options.create_if_missing = false;
+        DB *secondary_db = nullptr;
+        write_status(
+                DB::OpenAsSecondary(options, db->db_path, convert_vec_to_string(opts.secondary_path), cf_descs,
+                                    &handles, &secondary_db),
+                status);
+        db->read_only_db.reset(secondary_db);
+        db->secondary = true;
+        txn_db = secondary_db;
+    } else if (opts.read_only) {
+        options.create_if_missing = false;
+        DB *read_only_db = nullptr;
+        write_status(DB::OpenForReadOnly(options, db->db_path, cf_descs, &handles, &read_only_db), status);
+        db->read_only_db.reset(read_only_db);
+        txn_db = read_only_db;
+    } else if (opts.optimistic) {
+        OptimisticTransactionDB *o_txn_db = nullptr;
+        write_status(
+                OptimisticTransactionDB::Open(options, db->db_path, cf_descs, &handles, &o_txn_db),
+                status);
+        db->odb.reset(o_txn_db);
+        txn_db = o_txn_db;
+    } else {
+        TransactionDBOptions txn_db_opts;
+        txn_db_opts.num_stripes = opts.lock_stripes;
+        txn_db_opts.transaction_lock_timeout = opts.lock_timeout_ms;
+        txn_db_opts.max_num_locks = opts.max_num_locks;
+        if (!opts.write_policy.empty()) {
+            static const map<string, TxnDBWritePolicy> policies = {
+                    {"committed",  WRITE_COMMITTED},
+                    {"prepared",   WRITE_PREPARED},
+                    {"unprepared", WRITE_UNPREPARED},
+            };
+            auto it = policies.find(string(opts.write_policy));
+            if (it == policies.end()) {
+                write_status(Status::InvalidArgument("unknown write policy", string(opts.write_policy)), status);
+                return nullptr;
+            }
+            txn_db_opts.write_policy = it->second;
+        }
+        txn_db_opts.default_write_batch_flush_threshold = opts.write_batch_flush_threshold;
+        db->write_committed = txn_db_opts.write_policy == WRITE_COMMITTED;
+        TransactionDB *p_txn_db = nullptr;
+        write_status(
+                TransactionDB::Open(options, txn_db_opts, db->db_path, cf_descs, &handles, &p_txn_db),
+                status);
+        db->db.reset(p_txn_db);
+        txn_db = p_txn_db;
+    }
+    db->open_micros = micros_since(open_start);
     db->destroy_on_exit = opts.destroy_on_exit;
+    db->deadlock_detect = opts.deadlock_detect;
+    db->deadlock_detect_depth = opts.deadlock_detect_depth;
+
+    if (txn_db != nullptr) {
+        db->cfs = make_shared<CfRegistry>(txn_db->DefaultColumnFamily());
+        for (size_t i = 0; i < handles.size(); ++i) {
+            uint64_t id;
+            if (i == 0) {
+                // `DefaultColumnFamily()` is used instead
+                txn_db->DestroyColumnFamilyHandle(handles[i]);
+            } else if (parse_relation_cf_name(cf_descs[i].name, id)) {
+                db->cfs->add(id, handles[i]);
+            } else {
+                db->cfs->retire(handles[i]);
+            }
+        }
+        db->reload_range_tombstone_counts(status);
+    }
 
 
     return db;
 }
 
+void RocksDbBridge::approximate_range_stats(RustBytes start, RustBytes end, RangeStats &stats) const {
+    auto db_ = get_base_db();
+    auto start_s = convert_slice(start);
+    auto cf = cfs->for_key(start_s);
+    Range range(start_s, convert_slice(end));
+
+    SizeApproximationOptions size_opts;
+    size_opts.include_files = true;
+    size_opts.include_memtables = false;
+    uint64_t file_bytes = 0;
+    if (db_->GetApproximateSizes(size_opts, cf, &range, 1, &file_bytes).ok()) {
+        stats.file_bytes = file_bytes;
+    }
+    db_->GetApproximateMemTableStats(cf, range, &stats.memtable_count, &stats.memtable_bytes);
+
+    uint64_t val = 0;
+    if (db_->GetIntProperty(cf, DB::Properties::kEstimateNumKeys, &val)) {
+        stats.cf_num_keys = val;
+    }
+    if (db_->GetIntProperty(cf, DB::Properties::kNumEntriesActiveMemTable, &val)) {
+        stats.cf_memtable_entries += val;
+    }
+    if (db_->GetIntProperty(cf, DB::Properties::kNumEntriesImmMemTables, &val)) {
+        stats.cf_memtable_entries += val;
+    }
+    if (db_->GetIntProperty(cf, DB::Properties::kEstimateLiveDataSize, &val)) {
+        stats.cf_live_bytes = val;
+    }
+}
+
+void RocksDbBridge::relation_table_stats(uint64_t id, RelationTableStats &stats, RocksDbStatus &status) const {
+    string start(RELATION_PREFIX_LEN, '\0');
+    string end(RELATION_PREFIX_LEN, '\0');
+    for (size_t i = 0; i < RELATION_PREFIX_LEN; ++i) {
+        auto shift = 8 * (RELATION_PREFIX_LEN - 1 - i);
+        start[i] = static_cast<char>((id >> shift) & 0xFF);
+        end[i] = static_cast<char>(((id + 1) >> shift) & 0xFF);
+    }
+    Range range(start, end);
+    TablePropertiesCollection props;
+    auto s = get_base_db()->GetPropertiesOfTablesInRange(cfs->for_id(id), &range, 1, &props);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    RelationTableCounts counts;
+    for (auto &pair: props) {
+        if (read_relation_counts(*pair.second, id, counts)) {
+            stats.num_files += 1;
+        }
+    }
+    stats.num_rows = counts.rows;
+    stats.key_bytes = counts.key_bytes;
+    stats.value_bytes = counts.value_bytes;
+    // Files of different levels may hold the same first keys, so the sum can only overestimate
+    stats.distinct_first_keys = min(counts.distinct_first_keys, counts.rows);
+    write_status(Status::OK(), status);
+}
+
+void RocksDbBridge::get_cache_stats(CacheStats &stats) const {
+    if (block_cache != nullptr) {
+        stats.block_cache_capacity = block_cache->GetCapacity();
+        stats.block_cache_usage = block_cache->GetUsage();
+        stats.block_cache_pinned_usage = block_cache->GetPinnedUsage();
+    }
+    if (row_cache != nullptr) {
+        stats.row_cache_capacity = row_cache->GetCapacity();
+        stats.row_cache_usage = row_cache->GetUsage();
+    }
+    if (statistics != nullptr) {
+        stats.statistics_enabled = true;
+        stats.block_cache_hit = statistics->getTickerCount(BLOCK_CACHE_HIT);
+        stats.block_cache_miss = statistics->getTickerCount(BLOCK_CACHE_MISS);
+        stats.block_cache_index_hit = statistics->getTickerCount(BLOCK_CACHE_INDEX_HIT);
+        stats.block_cache_index_miss = statistics->getTickerCount(BLOCK_CACHE_INDEX_MISS);
+        stats.block_cache_filter_hit = statistics->getTickerCount(BLOCK_CACHE_FILTER_HIT);
+        stats.block_cache_filter_miss = statistics->getTickerCount(BLOCK_CACHE_FILTER_MISS);
+        stats.block_cache_data_hit = statistics->getTickerCount(BLOCK_CACHE_DATA_HIT);
+        stats.block_cache_data_miss = statistics->getTickerCount(BLOCK_CACHE_DATA_MISS);
+        stats.row_cache_hit = statistics->getTickerCount(ROW_CACHE_HIT);
+        stats.row_cache_miss = statistics->getTickerCount(ROW_CACHE_MISS);
+    }
+}
+
+void RocksDbBridge::get_open_timings(OpenTimings &timings) const {
+    timings.load_options_micros = load_options_micros;
+    timings.open_micros = open_micros;
+}
+
+void SnapshotBridge::multi_get(RustBytes keys, rust::Slice<const size_t> key_offsets, bool with_values,
+                               rust::Vec<uint8_t> &vals, rust::Vec<size_t> &val_offsets, rust::Vec<bool> &found,
+                               RocksDbStatus &status) const {
+    auto key_slices = unpack_keys(keys, key_offsets);
+    auto n = key_slices.size();
+    vector<ColumnFamilyHandle *> key_cfs;
+    key_cfs.reserve(n);
+    for (auto &k: key_slices) {
+        key_cfs.push_back(cfs->for_key(k));
+    }
+    vector<PinnableSlice> values(n);
+    vector<Status> statuses(n);
+    db->MultiGet(*r_opts, n, key_cfs.data(), key_slices.data(), values.data(), statuses.data());
+    pack_multi_get_results(statuses, values, with_values, vals, val_offsets, found, status);
+}
+
+void RocksDbBridge::ingest_ssts(rust::Slice<const rust::String> paths, rust::Slice<const uint64_t> relation_ids,
+                                RocksDbStatus &status) const {
+    vector<IngestExternalFileArg> args;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        auto cf = cfs->for_id(relation_ids[i]);
+        auto it = std::find_if(args.begin(), args.end(),
+                               [cf](const IngestExternalFileArg &arg) { return arg.column_family == cf; });
+        if (it == args.end()) {
+            IngestExternalFileArg arg;
+            arg.column_family = cf;
+            arg.options.move_files = true;
+            args.push_back(arg);
+            it = args.end() - 1;
+        }
+        it->external_files.emplace_back(string(paths[i]));
+    }
+    if (args.empty()) {
+        write_status(Status::OK(), status);
+        return;
+    }
+    write_status(get_base_db()->IngestExternalFiles(args), status);
+}
+
+void RocksDbBridge::flush(RocksDbStatus &status) const {
+    auto db_ = get_db();
+    vector<ColumnFamilyHandle *> handles{db_->DefaultColumnFamily()};
+    for (auto id: cfs->ids()) {
+        handles.push_back(cfs->for_id(id));
+    }
+    FlushOptions options;
+    options.wait = true;
+    write_status(db_->Flush(options, handles), status);
+}
+
+void RocksDbBridge::drop_range(RustBytes start, RustBytes end, RocksDbStatus &status) const {
+    del_range(start, end, status);
+    if (status.code != StatusCode::kOk) {
+        return;
+    }
+    auto db_ = get_base_db();
+    uint64_t num_snapshots = 0;
+    if (!db_->GetIntProperty(DB::Properties::kNumSnapshots, &num_snapshots) || num_snapshots > 0) {
+        return;
+    }
+    auto start_s = convert_slice(start);
+    auto end_s = convert_slice(end);
+    auto cf = cfs->for_key(start_s);
+    vector<LiveFileMetaData> files;
+    db_->GetLiveFilesMetaData(&files);
+    for (auto &file: files) {
+        if (file.column_family_name != cf->GetName()) {
+            continue;
+        }
+        Slice smallest(file.smallestkey), largest(file.largestkey);
+        bool overlaps = smallest.compare(end_s) < 0 && largest.compare(start_s) >= 0;
+        bool contained = smallest.compare(start_s) >= 0 && largest.compare(end_s) < 0;
+        if (overlaps && !contained) {
+            return;
+        }
+    }
+    auto s = DeleteFilesInRange(db_, cf, &start_s, &end_s, false);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    // Files deleted this way are not reported to the counter
+    write_status(range_tombstones->reload(db_, cf), status);
+}
+
+void RocksDbBridge::create_checkpoint(rust::Str path, RocksDbStatus &status) const {
+    Checkpoint *checkpoint = nullptr;
+    auto s = Checkpoint::Create(get_db(), &checkpoint);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    unique_ptr<Checkpoint> checkpoint_guard(checkpoint);
+    write_status(checkpoint->CreateCheckpoint(string(path)), status);
+}
+
+void RocksDbBridge::compact_range(RustBytes start, RustBytes end, RocksDbStatus &status) const {
+    CompactRangeOptions options;
+    // Let automatic compactions of other ranges go on meanwhile
+    options.exclusive_manual_compaction = false;
+    auto db_ = get_db();
+    auto cf = db_->DefaultColumnFamily();
+    auto start_s = convert_slice(start);
+    auto end_s = convert_slice(end);
+    auto s = db_->CompactRange(options, cf, &start_s, &end_s);
+    if (!s.ok()) {
+        write_status(s, status);
+        return;
+    }
+    // Column families of relations within the range are compacted as a whole
+    uint64_t start_id = start_s.size() < RELATION_PREFIX_LEN ? 0 : decode_relation_prefix(start_s);
+    uint64_t end_id = end_s.size() < RELATION_PREFIX_LEN ? 0 : decode_relation_prefix(end_s);
+    // An end that is a bare prefix excludes the relation it names
+    bool end_exclusive = end_s.size() == RELATION_PREFIX_LEN;
+    for (auto id: cfs->ids()) {
+        if (id < start_id || id > end_id || (end_exclusive && id == end_id)) {
+            continue;
+        }
+        auto relation_cf = cfs->for_id(id);
+        if (relation_cf == cf) {
+            continue;
+        }
+        s = db_->CompactRange(options, relation_cf, nullptr, nullptr);
+        if (!s.ok()) {
+            break;
+        }
+    }
+    write_status(s, status);
+}
+
+void RocksDbBridge::reload_range_tombstone_counts(RocksDbStatus &status) const {
+    auto db_ = get_base_db();
+    vector<ColumnFamilyHandle *> handles{db_->DefaultColumnFamily()};
+    for (auto id: cfs->ids()) {
+        handles.push_back(cfs->for_id(id));
+    }
+    for (auto handle: handles) {
+        auto s = range_tombstones->reload(db_, handle);
+        if (!s.ok()) {
+            write_status(s, status);
+            return;
+        }
+    }
+    write_status(Status::OK(), status);
+}
+
+void RocksDbBridge::create_relation_cf(uint64_t id, const CfOpts &opts, RocksDbStatus &status) const {
+    if (cfs->contains(id)) {
+        write_status(Status::OK(), status);
+        return;
+    }
+    ColumnFamilyOptions cf_opts = relation_cf_options;
+    if (!opts.compression.empty()) {
+        static const map<string, CompressionType> compressions = {
+                {"none",   kNoCompression},
+                {"snappy", kSnappyCompression},
+                {"lz4",    kLZ4Compression},
+                {"lz4hc",  kLZ4HCCompression},
+                {"zstd",   kZSTD},
+        };
+        auto it = compressions.find(string(opts.compression));
+        if (it == compressions.end()) {
+            write_status(Status::InvalidArgument("unknown compression", string(opts.compression)), status);
+            return;
+        }
+        cf_opts.compression = it->second;
+        cf_opts.bottommost_compression = it->second;
+    }
+    if (!opts.compaction_style.empty()) {
+        static const map<string, CompactionStyle> styles = {
+                {"level",     kCompactionStyleLevel},
+                {"universal", kCompactionStyleUniversal},
+                {"fifo",      kCompactionStyleFIFO},
+        };
+        auto it = styles.find(string(opts.compaction_style));
+        if (it == styles.end()) {
+            write_status(Status::InvalidArgument("unknown compaction style", string(opts.compaction_style)),
+                         status);
+            return;
+        }
+        cf_opts.compaction_style = it->second;
+        if (it->second != kCompactionStyleLevel) {
+            cf_opts.level_compaction_dynamic_level_bytes = false;
+        }
+    }
+    if (opts.prefix_len > 0) {
+        cf_opts.prefix_extractor.reset(NewCappedPrefixTransform(opts.prefix_len));
+    }
+    if (opts.block_size > 0 || opts.bloom_filter_bits_per_key > 0) {
+        auto *base_table_options = cf_opts.table_factory->GetOptions<BlockBasedTableOptions>();
+        if (base_table_options != nullptr) {
+            BlockBasedTableOptions table_options = *base_table_options;
+            if (opts.block_size > 0) {
+                table_options.block_size = opts.block_size;
+            }
+            if (opts.bloom_filter_bits_per_key > 0) {
+                table_options.filter_policy.reset(new_filter_policy(opts.bloom_filter_bits_per_key, use_ribbon_filter));
+            }
+            cf_opts.table_factory.reset(NewBlockBasedTableFactory(table_options));
+        }
+    }
+    ColumnFamilyHandle *handle = nullptr;
+    auto s = get_db()->CreateColumnFamily(cf_opts, relation_cf_name(id), &handle);
+    if (s.ok()) {
+        cfs->add(id, handle);
+    }
+    write_status(s, status);
+}
+
+void RocksDbBridge::drop_relation_cf(uint64_t id, RocksDbStatus &status) const {
+    auto handle = cfs->remove(id);
+    if (handle == nullptr) {
+        write_status(Status::OK(), status);
+        return;
+    }
+    auto s = get_db()->DropColumnFamily(handle);
+    if (s.ok()) {
+        range_tombstones->forget(handle->GetName());
+    }
+    write_status(s, status);
+}
+
+bool CozoMergeOperator::FullMergeV2(const MergeOperationInput &merge_in,
+                                    MergeOperationOutput *merge_out) const {
+    string operands;
+    vector<size_t> offsets;
+    offsets.reserve(merge_in.operand_list.size());
+    for (auto &operand: merge_in.operand_list) {
+        operands.append(operand.data(), operand.size());
+        offsets.push_back(operands.size());
+    }
+    auto has_existing = merge_in.existing_value != nullptr;
+    auto existing = has_existing ? convert_slice_back(*merge_in.existing_value) : RustBytes();
+    rust::Vec<uint8_t> merged;
+    auto ok = merge_values(existing, has_existing,
+                           RustBytes(reinterpret_cast<const uint8_t *>(operands.data()), operands.size()),
+                           rust::Slice<const size_t>(offsets.data(), offsets.size()),
+                           merged);
+    if (!ok) {
+        return false;
+    }
+    merge_out->new_value.assign(reinterpret_cast<const char *>(merged.data()), merged.size());
+    return true;
+}
+
+void start_perf_context() {
+    SetPerfLevel(PerfLevel::kEnableCount);
+    get_perf_context()->Reset();
+    get_iostats_context()->Reset();
+}
+
+void stop_perf_context(PerfStats &stats) {
+    auto ctx = get_perf_context();
+    stats.block_cache_hit_count = ctx->block_cache_hit_count;
+    stats.block_read_count = ctx->block_read_count;
+    stats.block_read_byte = ctx->block_read_byte;
+    stats.bytes_read = get_iostats_context()->bytes_read;
+    stats.get_from_memtable_count = ctx->get_from_memtable_count;
+    stats.seek_count = ctx->iter_seek_count;
+    stats.next_count = ctx->iter_next_count;
+    stats.bloom_sst_useful = ctx->bloom_sst_miss_count;
+    stats.bloom_sst_checked = ctx->bloom_sst_hit_count + ctx->bloom_sst_miss_count;
+    stats.internal_key_skipped_count = ctx->internal_key_skipped_count;
+    stats.internal_delete_skipped_count = ctx->internal_delete_skipped_count;
+    stats.internal_range_del_reseek_count = ctx->internal_range_del_reseek_count;
+    SetPerfLevel(PerfLevel::kDisable);
+}
+
 RocksDbBridge::~RocksDbBridge() {
-    if (destroy_on_exit && (db != nullptr)) {
+    bool is_open = db != nullptr || odb != nullptr || read_only_db != nullptr;
+    if (is_open && cfs != nullptr) {
+        for (auto handle: cfs->all_handles()) {
+            get_db()->DestroyColumnFamilyHandle(handle);
+        }
+    }
+    // The files of a read-only instance belong to another
+    if (destroy_on_exit && is_open && read_only_db == nullptr) {
         cerr << "destroying database on exit: " << db_path << endl;
-        auto status = db->Close();
+        auto status = get_db()->Close();
         if (!status.ok()) {
             cerr << status.ToString() << endl;
         }
         db.reset();
+        odb.reset();
         Options options{};
         auto status2 = DestroyDB(db_path, options);
         if (!status2.ok()) {
@@ -13,12 +13,51 @@
 #include "common.h"
 #include "tx.h"
 #include "slice.h"
+#include "cf.h"
+#include "version_gc.h"
+#include "merge.h"
+#include "table_stats.h"
+#include "partitioner.h"
+#include "wal.h"
 
+// Reads from a snapshot of the base database, for read-only transactions.
+// Unlike `TxBridge`, there is no transaction object, no write buffer and no locking.
 struct SnapshotBridge {
     const Snapshot *snapshot;
     DB *db;
+    shared_ptr<CfRegistry> cfs;
+    unique_ptr<ReadOptions> r_opts;
 
-    explicit SnapshotBridge(const Snapshot *snapshot_, DB *db_) : snapshot(snapshot_), db(db_) {}
+    explicit SnapshotBridge(DB *db_, shared_ptr<CfRegistry> cfs_) : snapshot(db_->GetSnapshot()), db(db_),
+                                                                   cfs(std::move(cfs_)),
+                                                                   r_opts(new ReadOptions) {
+        r_opts->snapshot = snapshot;
+        r_opts->ignore_range_deletions = true;
+    }
+
+    inline unique_ptr<PinnableSlice> get(RustBytes key, RocksDbStatus &status) const {
+        Slice key_ = convert_slice(key);
+        auto ret = make_unique<PinnableSlice>();
+        write_status(db->Get(*r_opts, cfs->for_key(key_), key_, &*ret), status);
+        return ret;
+    }
+
+    inline void exists(RustBytes key, RocksDbStatus &status) const {
+        Slice key_ = convert_slice(key);
+        auto ret = PinnableSlice();
+        write_status(db->Get(*r_opts, cfs->for_key(key_), key_, &ret), status);
+    }
+
+    // Same layout as `TxBridge::multi_get`
+    void multi_get(RustBytes keys, rust::Slice<const size_t> key_offsets, bool with_values,
+                   rust::Vec<uint8_t> &vals, rust::Vec<size_t> &val_offsets, rust::Vec<bool> &found,
+                   RocksDbStatus &status) const;
+
+    inline unique_ptr<IterBridge> iterator() const {
+        auto ret = make_unique<IterBridge>(db, cfs);
+        ret->set_snapshot(snapshot);
+        return ret;
+    }
 
     ~SnapshotBridge() {
         db->ReleaseSnapshot(snapshot);
@@ -29,7 +68,7 @@ struct SnapshotBridge {
 struct SstFileWriterBridge {
     SstFileWriter inner;
 
-    SstFileWriterBridge(EnvOptions eopts, Options opts) : inner(eopts, opts) {
+    SstFileWriterBridge(EnvOptions eopts, Options opts, ColumnFamilyHandle *cf) : inner(eopts, opts, cf) {
     }
 
     inline void finish(RocksDbStatus &status) {
@@ -42,32 +81,87 @@ struct SstFileWriterBridge {
 
 };
 
+// Accumulates writes to the base database, bypassing transactions, and applies them atomically on commit.
+struct WriteBatchBridge {
+    DB *db;
+    shared_ptr<CfRegistry> cfs;
+    WriteBatch batch;
+    WriteOptions w_opts;
+
+    explicit WriteBatchBridge(DB *db_, shared_ptr<CfRegistry> cfs_) : db(db_), cfs(std::move(cfs_)) {}
+
+    inline void put(RustBytes key, RustBytes val, RocksDbStatus &status) {
+        auto key_s = convert_slice(key);
+        write_status(batch.Put(cfs->for_key(key_s), key_s, convert_slice(val)), status);
+    }
+
+    inline void disable_wal(bool val) {
+        w_opts.disableWAL = val;
+    }
+
+    [[nodiscard]] inline size_t count() const {
+        return batch.Count();
+    }
+
+    [[nodiscard]] inline size_t data_size() const {
+        return batch.GetDataSize();
+    }
+
+    // Writes out the accumulated puts and clears the batch for reuse.
+    inline void commit(RocksDbStatus &status) {
+        auto s = db->Write(w_opts, &batch);
+        batch.Clear();
+        write_status(s, status);
+    }
+};
+
 static WriteOptions DEFAULT_WRITE_OPTIONS = WriteOptions();
 
 struct RocksDbBridge {
+    // Exactly one of `db` and `odb` is set, depending on whether transactions are pessimistic or optimistic,
+    // unless the database is opened read-only, possibly as a secondary instance, when only `read_only_db` is set
     unique_ptr<TransactionDB> db;
+    unique_ptr<OptimisticTransactionDB> odb;
+    unique_ptr<DB> read_only_db;
+    bool secondary = false;
+    shared_ptr<CfRegistry> cfs;
+    shared_ptr<RetentionRegistry> retention;
+    shared_ptr<RangeTombstoneCounter> range_tombstones;
+    ColumnFamilyOptions relation_cf_options;
+    shared_ptr<Cache> block_cache;
+    shared_ptr<Cache> row_cache;
+    shared_ptr<Statistics> statistics;
 
     bool destroy_on_exit;
     string db_path;
+    // Filters of column families created for relations are of the same kind as the default one
+    bool use_ribbon_filter = false;
+    // False when the memtable may hold writes of transactions that are not committed yet,
+    // which only the transaction layer can tell apart
+    bool write_committed = true;
+    // Applied to each pessimistic transaction
+    bool deadlock_detect = false;
+    int64_t deadlock_detect_depth = 50;
+    uint64_t load_options_micros = 0;
+    uint64_t open_micros = 0;
 
-    inline unique_ptr<SstFileWriterBridge> get_sst_writer(rust::Str path, RocksDbStatus &status) const {
+    // The file is written with the options of the column family holding the relation with the given id.
+    inline unique_ptr<SstFileWriterBridge>
+    get_sst_writer(rust::Str path, uint64_t relation_id, RocksDbStatus &status) const {
         DB *db_ = get_base_db();
-        auto cf = db->DefaultColumnFamily();
+        auto cf = cfs->for_id(relation_id);
         Options options_ = db_->GetOptions(cf);
-        auto sst_file_writer = std::make_unique<SstFileWriterBridge>(EnvOptions(), options_);
+        auto sst_file_writer = std::make_unique<SstFileWriterBridge>(EnvOptions(), options_, cf);
         string path_(path);
 
         write_status(sst_file_writer->inner.Open(path_), status);
         return sst_file_writer;
     }
 
-    inline void ingest_sst(rust::Str path, RocksDbStatus &status) const {
-        IngestExternalFileOptions ifo;
-        DB *db_ = get_base_db();
-        string path_(path);
-        auto cf = db->DefaultColumnFamily();
-        write_status(db_->IngestExternalFile(cf, {std::move(path_)}, ifo), status);
-    }
+    // Ingests all files atomically, each into the column family holding the relation given at the same position
+    // in `relation_ids`. The files are moved into the database rather than copied.
+    void ingest_ssts(rust::Slice<const rust::String> paths, rust::Slice<const uint64_t> relation_ids,
+                     RocksDbStatus &status) const;
 
     [[nodiscard]] inline const string &get_db_path() const {
         return db_path;
@@ -75,19 +169,43 @@ struct RocksDbBridge {
 
 
     [[nodiscard]] inline unique_ptr<TxBridge> transact() const {
-        auto ret = make_unique<TxBridge>(&*this->db, db->DefaultColumnFamily());
+        if (odb != nullptr) {
+            return make_unique<TxBridge>(&*this->odb, cfs);
+        }
+        auto ret = make_unique<TxBridge>(&*this->db, cfs);
+        ret->p_tx_opts->deadlock_detect = deadlock_detect;
+        ret->p_tx_opts->deadlock_detect_depth = deadlock_detect_depth;
         return ret;
     }
 
+    [[nodiscard]] inline unique_ptr<WriteBatchBridge> write_batch() const {
+        return make_unique<WriteBatchBridge>(get_direct_db(), cfs);
+    }
+
+    // Flushes the memtables of all column families, waiting for completion.
+    void flush(RocksDbStatus &status) const;
+
+    [[nodiscard]] inline unique_ptr<SnapshotBridge> snapshot() const {
+        return make_unique<SnapshotBridge>(get_direct_db(), cfs);
+    }
+
+    // Writes a range tombstone over [start, end). Reads set `ignore_range_deletions` and do not see
+    // the tombstone, so this is only for ranges whose rows are already deleted key by key, such as
+    // those of destroyed relations, where it lets compactions and file deletion reclaim them sooner.
     inline void del_range(RustBytes start, RustBytes end, RocksDbStatus &status) const {
         WriteBatch batch;
-        auto cf = db->DefaultColumnFamily();
-        auto s = batch.DeleteRange(cf, convert_slice(start), convert_slice(end));
+        auto start_s = convert_slice(start);
+        auto cf = cfs->for_key(start_s);
+        auto s = batch.DeleteRange(cf, start_s, convert_slice(end));
         if (!s.ok()) {
             write_status(s, status);
             return;
         }
         WriteOptions w_opts;
+        if (odb != nullptr) {
+            write_status(odb->Write(w_opts, &batch), status);
+            return;
+        }
         TransactionDBWriteOptimizations optimizations;
         optimizations.skip_concurrency_control = true;
         optimizations.skip_duplicate_key_check = true;
@@ -96,22 +214,116 @@ struct RocksDbBridge {
     }
 
     inline void put(RustBytes key, RustBytes val, RocksDbStatus &status) const {
-        auto raw_db = this->get_base_db();
-        auto s = raw_db->Put(DEFAULT_WRITE_OPTIONS, convert_slice(key), convert_slice(val));
+        auto raw_db = this->get_direct_db();
+        auto key_s = convert_slice(key);
+        auto s = raw_db->Put(DEFAULT_WRITE_OPTIONS, cfs->for_key(key_s), key_s, convert_slice(val));
         write_status(s, status);
     }
 
-    void compact_range(RustBytes start, RustBytes end, RocksDbStatus &status) const {
-        CompactRangeOptions options;
-        auto cf = db->DefaultColumnFamily();
-        auto start_s = convert_slice(start);
-        auto end_s = convert_slice(end);
-        auto s = db->CompactRange(options, cf, &start_s, &end_s);
-        write_status(s, status);
+    // Deletes [start, end) with a range tombstone, then drops the SST files of the range at once,
+    // unless a snapshot may still read them. Files are only dropped if all of those overlapping the
+    // range lie entirely within it: dropping a newer file holding deletions of keys whose older
+    // versions sit in a file reaching out of the range would bring those versions back.
+    void drop_range(RustBytes start, RustBytes end, RocksDbStatus &status) const;
+
+    void compact_range(RustBytes start, RustBytes end, RocksDbStatus &status) const;
+
+    // Number of range tombstones in the SST files of all column families. A tombstone stays until
+    // compactions have brought it down to the last level holding keys of its range.
+    [[nodiscard]] inline uint64_t range_tombstone_count() const {
+        return range_tombstones->total();
+    }
+
+    // Counts the range tombstones of every column family afresh.
+    void reload_range_tombstone_counts(RocksDbStatus &status) const;
+
+    // Creates an openable copy of the database at `path`, which must not exist. SST files are hard-linked
+    // when `path` is on the same file system, and copied otherwise.
+    void create_checkpoint(rust::Str path, RocksDbStatus &status) const;
+
+    void create_relation_cf(uint64_t id, const CfOpts &opts, RocksDbStatus &status) const;
+
+    void drop_relation_cf(uint64_t id, RocksDbStatus &status) const;
+
+    [[nodiscard]] inline rust::Vec<uint64_t> relation_cf_ids() const {
+        rust::Vec<uint64_t> ret;
+        for (auto id: cfs->ids()) {
+            ret.push_back(id);
+        }
+        return ret;
+    }
+
+    // Versions of the relation older than `retention_micros` are dropped by compactions,
+    // except for the newest one of each row at that point.
+    inline void set_relation_retention(uint64_t id, int64_t retention_micros) const {
+        retention->set(id, retention_micros);
+    }
+
+    inline void clear_relation_retention(uint64_t id) const {
+        retention->clear(id);
+    }
+
+    void get_cache_stats(CacheStats &stats) const;
+
+    void get_open_timings(OpenTimings &timings) const;
+
+    // The write batches in the write-ahead log from the one holding `seq` on. Fails if the log
+    // files holding `seq` are gone.
+    inline unique_ptr<WalIterBridge> updates_since(uint64_t seq, RocksDbStatus &status) const {
+        auto ret = make_unique<WalIterBridge>();
+        write_status(get_base_db()->GetUpdatesSince(seq, &ret->iter), status);
+        return ret;
+    }
+
+    [[nodiscard]] inline uint64_t latest_sequence_number() const {
+        return get_base_db()->GetLatestSequenceNumber();
+    }
+
+    // Approximations for the keys in [start, end), which must lie in the column family of `start`.
+    void approximate_range_stats(RustBytes start, RustBytes end, RangeStats &stats) const;
+
+    // Sums the statistics recorded for the relation in the properties of the SST files holding it.
+    // Rows still in memtables are not included.
+    void relation_table_stats(uint64_t id, RelationTableStats &stats, RocksDbStatus &status) const;
+
+    DB *get_db() const {
+        if (db != nullptr) {
+            return &*db;
+        }
+        if (odb != nullptr) {
+            return &*odb;
+        }
+        return &*read_only_db;
+    }
+
+    [[nodiscard]] inline bool is_secondary() const {
+        return secondary;
+    }
+
+    [[nodiscard]] inline bool is_read_only() const {
+        return read_only_db != nullptr;
+    }
+
+    // Applies the changes the primary made since the last call. Column families the primary created
+    // in the meantime are not opened.
+    // Also recounts the range tombstones, as the files of a secondary instance change without events.
+    inline void try_catch_up_with_primary(RocksDbStatus &status) const {
+        auto s = get_db()->TryCatchUpWithPrimary();
+        if (!s.ok()) {
+            write_status(s, status);
+            return;
+        }
+        reload_range_tombstone_counts(status);
     }
 
     DB *get_base_db() const {
-        return db->GetBaseDB();
+        return get_db()->GetBaseDB();
+    }
+
+    // For reads and writes outside of transactions. They bypass the transaction layer,
+    // except under write policies other than WRITE_COMMITTED, where it decides what is visible.
+    DB *get_direct_db() const {
+        return write_committed ? get_base_db() : get_db();
     }
 
     ~RocksDbBridge();
@@ -120,4 +332,10 @@ struct RocksDbBridge {
 shared_ptr<RocksDbBridge>
 open_db(const DbOpts &opts, RocksDbStatus &status);
 
+// Starts counting the work RocksDB does on the calling thread, resetting previous counts.
+void start_perf_context();
+
+// Reads the counts since `start_perf_context` was called on the calling thread, and stops counting.
+void stop_perf_context(PerfStats &stats);
+
 #endif //COZOROCKS_DB_H
@@ -10,10 +10,13 @@
 #include "common.h"
 #include "slice.h"
 #include "status.h"
+#include "cf.h"
 
 struct IterBridge {
     DB *db;
     Transaction *tx;
+    shared_ptr<CfRegistry> cfs;
+    ColumnFamilyHandle *cf;
     unique_ptr<Iterator> iter;
     string lower_storage;
     string upper_storage;
@@ -21,13 +24,30 @@ struct IterBridge {
     Slice upper_bound;
     unique_ptr<ReadOptions> r_opts;
 
-    explicit IterBridge(Transaction *tx_) : db(nullptr), tx(tx_), iter(nullptr), lower_bound(),
-                                                                     upper_bound(),
-                                                                     r_opts(new ReadOptions) {
+    explicit IterBridge(Transaction *tx_, shared_ptr<CfRegistry> cfs_) : db(nullptr), tx(tx_), cfs(std::move(cfs_)),
+                                                                         cf(cfs->default_cf), iter(nullptr),
+                                                                         lower_bound(),
+                                                                         upper_bound(),
+                                                                         r_opts(new ReadOptions) {
         r_opts->ignore_range_deletions = true;
         r_opts->auto_prefix_mode = true;
     }
 
+    explicit IterBridge(DB *db_, shared_ptr<CfRegistry> cfs_) : db(db_), tx(nullptr), cfs(std::move(cfs_)),
+                                                                cf(cfs->default_cf), iter(nullptr),
+                                                                lower_bound(),
+                                                                upper_bound(),
+                                                                r_opts(new ReadOptions) {
+        r_opts->ignore_range_deletions = true;
+        r_opts->auto_prefix_mode = true;
+    }
+
+    // Iterate over the column family holding the relation of `key`. The iterator never crosses
+    // column families, so a scan spanning several relations must be split by the caller.
+    inline void use_cf_of(RustBytes key) {
+        cf = cfs->for_key(convert_slice(key));
+    }
+
     inline void set_snapshot(const Snapshot *snapshot) {
         r_opts->snapshot = snapshot;
     }
@@ -85,9 +105,9 @@ struct IterBridge {
 
     inline void start() {
         if (db == nullptr) {
-            iter.reset(tx->GetIterator(*r_opts));
+            iter.reset(tx->GetIterator(*r_opts, cf));
         } else {
-            iter.reset(db->NewIterator(*r_opts));
+            iter.reset(db->NewIterator(*r_opts, cf));
         }
     }
 
@@ -135,6 +155,39 @@ struct IterBridge {
     [[nodiscard]] inline RustBytes val() const {
         return convert_slice_back(iter->value());
     }
+
+    // Copies rows starting from the current position into `buf`, advancing the iterator past them.
+    // `offsets` starts with 0 and receives the end offsets of each key and each value in turn,
+    // so that row `i` has key `buf[offsets[2i]..offsets[2i+1]]` and value `buf[offsets[2i+1]..offsets[2i+2]]`.
+    // Stops after `max_rows` rows, once `max_bytes` has been reached, or before the first key not below
+    // `end` unless it is empty. Returns the number of rows.
+    // The rows are gathered on this side first, so that they cross over to Rust in one copy.
+    size_t next_batch(size_t max_rows, size_t max_bytes, RustBytes end, rust::Vec<uint8_t> &buf,
+                      rust::Vec<size_t> &offsets, RocksDbStatus &status) {
+        auto end_key = convert_slice(end);
+        string rows;
+        vector<size_t> ends{0};
+        size_t n = 0;
+        while (n < max_rows && rows.size() < max_bytes && iter->Valid()) {
+            auto key = iter->key();
+            if (!end_key.empty() && key.compare(end_key) >= 0) {
+                break;
+            }
+            rows.append(key.data(), key.size());
+            ends.push_back(rows.size());
+            auto value = iter->value();
+            rows.append(value.data(), value.size());
+            ends.push_back(rows.size());
+            ++n;
+            iter->Next();
+        }
+        buf.clear();
+        offsets.clear();
+        append_to_rust_vec(buf, rows);
+        append_to_rust_vec(offsets, ends);
+        write_status(iter->status(), status);
+        return n;
+    }
 };
 
 #endif //COZOROCKS_ITER_H
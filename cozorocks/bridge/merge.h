@@ -0,0 +1,23 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_MERGE_H
+#define COZOROCKS_MERGE_H
+
+#include "common.h"
+
+// Hands the existing value and the merge operands of a key to the function installed with
+// `set_merge_fn` on the Rust side, which knows how Cozo encodes values.
+class CozoMergeOperator : public MergeOperator {
+public:
+    bool FullMergeV2(const MergeOperationInput &merge_in, MergeOperationOutput *merge_out) const override;
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoMergeOperator";
+    }
+};
+
+#endif //COZOROCKS_MERGE_H
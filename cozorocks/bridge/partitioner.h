@@ -0,0 +1,58 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_PARTITIONER_H
+#define COZOROCKS_PARTITIONER_H
+
+#include <cstring>
+
+#include "common.h"
+
+// Cuts compaction output files wherever the first `prefix_len` bytes of the keys change. With the
+// length of the relation id prefix, no file holds rows of more than one relation, so that scans of a
+// relation only read its own files, and removing a relation can drop its files whole.
+class PrefixSstPartitioner : public SstPartitioner {
+    size_t prefix_len;
+
+public:
+    explicit PrefixSstPartitioner(size_t prefix_len_) : prefix_len(prefix_len_) {}
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoPrefixSstPartitioner";
+    }
+
+    PartitionerResult ShouldPartition(const PartitionerRequest &request) override {
+        auto &prev = *request.prev_user_key;
+        auto &cur = *request.current_user_key;
+        auto prev_len = min(prev.size(), prefix_len);
+        auto cur_len = min(cur.size(), prefix_len);
+        if (prev_len != cur_len || memcmp(prev.data(), cur.data(), prev_len) != 0) {
+            return kRequired;
+        }
+        return kNotRequired;
+    }
+
+    bool CanDoTrivialMove(const Slice &smallest_user_key, const Slice &largest_user_key) override {
+        return ShouldPartition(PartitionerRequest(smallest_user_key, largest_user_key, 0)) == kNotRequired;
+    }
+};
+
+class PrefixSstPartitionerFactory : public SstPartitionerFactory {
+    size_t prefix_len;
+
+public:
+    explicit PrefixSstPartitionerFactory(size_t prefix_len_) : prefix_len(prefix_len_) {}
+
+    [[nodiscard]] unique_ptr<SstPartitioner> CreatePartitioner(const SstPartitioner::Context &) const override {
+        return make_unique<PrefixSstPartitioner>(prefix_len);
+    }
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoPrefixSstPartitionerFactory";
+    }
+};
+
+#endif //COZOROCKS_PARTITIONER_H
@@ -0,0 +1,16 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "slice.h"
+#include "cozorocks/src/bridge/mod.rs.h"
+
+void append_to_rust_vec(rust::Vec<uint8_t> &v, const Slice &s) {
+    extend_bytes(v, convert_slice_back(s));
+}
+
+void append_to_rust_vec(rust::Vec<size_t> &v, const vector<size_t> &items) {
+    extend_offsets(v, rust::Slice<const size_t>(items.data(), items.size()));
+}
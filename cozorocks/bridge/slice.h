@@ -29,4 +29,10 @@ inline RustBytes convert_pinnable_slice_back(const PinnableSlice &s) {
     return {reinterpret_cast<const std::uint8_t *>(s.data()), s.size()};
 }
 
+// Appends to a Rust vector with a single call into Rust, which copies the data in one go.
+// Going through `push_back` instead would call into Rust once per element.
+void append_to_rust_vec(rust::Vec<uint8_t> &v, const Slice &s);
+
+void append_to_rust_vec(rust::Vec<size_t> &v, const vector<size_t> &items);
+
 #endif //COZOROCKS_SLICE_H
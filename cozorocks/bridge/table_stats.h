@@ -0,0 +1,290 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_TABLE_STATS_H
+#define COZOROCKS_TABLE_STATS_H
+
+#include <map>
+#include <mutex>
+
+#include "common.h"
+#include "cf.h"
+
+static const char RELATION_STATS_PROPERTY[] = "cozo.relation_stats";
+
+// Length of the memcmp-encoded value at the start of `data`, or 0 if it cannot be decoded.
+// Mirrors `MemCmpEncoder::encode_datavalue` in cozo-core.
+inline size_t encoded_value_len(const char *data, size_t len) {
+    static const size_t ENC_GROUP_SIZE = 8;
+    static const uint8_t ENC_MARKER = 0xFF;
+    if (len == 0) {
+        return 0;
+    }
+    auto byte_at = [data](size_t i) { return static_cast<uint8_t>(data[i]); };
+    auto bytes_len = [&](size_t start) -> size_t {
+        for (size_t pos = start + ENC_GROUP_SIZE; pos < len; pos += ENC_GROUP_SIZE + 1) {
+            if (byte_at(pos) != ENC_MARKER) {
+                return pos + 1;
+            }
+        }
+        return 0;
+    };
+    switch (byte_at(0)) {
+        case 0x01: // null
+        case 0x02: // false
+        case 0x03: // true
+        case 0xFF: // bottom
+            return 1;
+        case 0x04: { // vector
+            if (len < 10) {
+                return 0;
+            }
+            uint64_t n = 0;
+            for (size_t i = 2; i < 10; ++i) {
+                n = (n << 8) | byte_at(i);
+            }
+            size_t total = 10 + n * (byte_at(1) == 0x01 ? 4 : 8);
+            return total <= len ? total : 0;
+        }
+        case 0x05: { // number, with an extra exact integer if it is too large for a float
+            if (len < 10) {
+                return 0;
+            }
+            size_t total = (byte_at(9) & 0b00000100) ? 18 : 10;
+            return total <= len ? total : 0;
+        }
+        case 0x06: // string
+        case 0x07: // bytes
+        case 0x09: // regex
+        case 0x0D: // json
+            return bytes_len(1);
+        case 0x08: // uuid
+            return len >= 17 ? 17 : 0;
+        case 0x0C: // validity
+            return len >= 10 ? 10 : 0;
+        case 0x0A: // list
+        case 0x0B: { // set
+            size_t pos = 1;
+            while (pos < len && byte_at(pos) != 0x00) {
+                auto el_len = encoded_value_len(data + pos, len - pos);
+                if (el_len == 0) {
+                    return 0;
+                }
+                pos += el_len;
+            }
+            return pos < len ? pos + 1 : 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+struct RelationTableCounts {
+    uint64_t rows = 0;
+    uint64_t key_bytes = 0;
+    uint64_t value_bytes = 0;
+    uint64_t distinct_first_keys = 0;
+};
+
+// Records, for each relation with rows in an SST file, the number of rows, their key and value sizes,
+// and the number of distinct values of the first key column. Keys arrive sorted, so the latter is
+// counted exactly within a file by comparing with the previous key. Only puts are counted.
+class RelationStatsCollector : public TablePropertiesCollector {
+    map<uint64_t, RelationTableCounts> counts;
+    uint64_t last_id = 0;
+    RelationTableCounts *last_counts = nullptr;
+    string last_first_key;
+
+public:
+    Status AddUserKey(const Slice &key, const Slice &value, EntryType type, SequenceNumber, uint64_t) override {
+        if (type != kEntryPut || key.size() < RELATION_PREFIX_LEN) {
+            return Status::OK();
+        }
+        auto id = decode_relation_prefix(key);
+        if (last_counts == nullptr || id != last_id) {
+            last_id = id;
+            last_counts = &counts[id];
+            last_first_key.clear();
+        }
+        last_counts->rows += 1;
+        last_counts->key_bytes += key.size();
+        last_counts->value_bytes += value.size();
+        auto first_key_len = encoded_value_len(key.data() + RELATION_PREFIX_LEN, key.size() - RELATION_PREFIX_LEN);
+        Slice first_key(key.data() + RELATION_PREFIX_LEN, first_key_len);
+        if (last_counts->distinct_first_keys == 0 || first_key != Slice(last_first_key)) {
+            last_counts->distinct_first_keys += 1;
+            last_first_key.assign(first_key.data(), first_key.size());
+        }
+        return Status::OK();
+    }
+
+    // Stored as one property holding a record of five big-endian integers per relation:
+    // the id, then the fields of `RelationTableCounts` in order.
+    Status Finish(UserCollectedProperties *properties) override {
+        string packed;
+        packed.reserve(counts.size() * 40);
+        auto put_u64 = [&packed](uint64_t v) {
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                packed.push_back(static_cast<char>((v >> shift) & 0xFF));
+            }
+        };
+        for (auto &pair: counts) {
+            put_u64(pair.first);
+            put_u64(pair.second.rows);
+            put_u64(pair.second.key_bytes);
+            put_u64(pair.second.value_bytes);
+            put_u64(pair.second.distinct_first_keys);
+        }
+        properties->emplace(RELATION_STATS_PROPERTY, std::move(packed));
+        return Status::OK();
+    }
+
+    [[nodiscard]] UserCollectedProperties GetReadableProperties() const override {
+        UserCollectedProperties ret;
+        for (auto &pair: counts) {
+            ret.emplace(string(RELATION_STATS_PROPERTY) + "." + to_string(pair.first),
+                        "rows=" + to_string(pair.second.rows) +
+                        " key_bytes=" + to_string(pair.second.key_bytes) +
+                        " value_bytes=" + to_string(pair.second.value_bytes) +
+                        " distinct_first_keys=" + to_string(pair.second.distinct_first_keys));
+        }
+        return ret;
+    }
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoRelationStatsCollector";
+    }
+};
+
+class RelationStatsCollectorFactory : public TablePropertiesCollectorFactory {
+public:
+    TablePropertiesCollector *CreateTablePropertiesCollector(TablePropertiesCollectorFactory::Context) override {
+        return new RelationStatsCollector();
+    }
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoRelationStatsCollectorFactory";
+    }
+};
+
+// Adds the collector to options that may have been loaded from a file, unless it is already there.
+inline void ensure_relation_stats_collector(ColumnFamilyOptions &options) {
+    for (auto &factory: options.table_properties_collector_factories) {
+        if (string(factory->Name()) == RelationStatsCollectorFactory().Name()) {
+            return;
+        }
+    }
+    options.table_properties_collector_factories.emplace_back(make_shared<RelationStatsCollectorFactory>());
+}
+
+// Adds the counts of relation `id` recorded in the properties of one table. Returns false if the table
+// has no rows of the relation.
+inline bool read_relation_counts(const TableProperties &props, uint64_t id, RelationTableCounts &counts) {
+    auto it = props.user_collected_properties.find(RELATION_STATS_PROPERTY);
+    if (it == props.user_collected_properties.end()) {
+        return false;
+    }
+    auto &packed = it->second;
+    auto get_u64 = [&packed](size_t pos) {
+        uint64_t v = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            v = (v << 8) | static_cast<uint8_t>(packed[pos + i]);
+        }
+        return v;
+    };
+    for (size_t pos = 0; pos + 40 <= packed.size(); pos += 40) {
+        if (get_u64(pos) == id) {
+            counts.rows += get_u64(pos + 8);
+            counts.key_bytes += get_u64(pos + 16);
+            counts.value_bytes += get_u64(pos + 24);
+            counts.distinct_first_keys += get_u64(pos + 32);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Counts the range tombstones in the SST files of each column family, keeping the counts up to date
+// from the table properties of the files that flushes, compactions and ingestions add and remove,
+// so that reading them does not go through the properties of every file. Changes are only tracked
+// once the counts are loaded, after the database is open; files that the database removes otherwise,
+// such as with `DeleteFilesInRange`, require reloading the counts of their column family.
+class RangeTombstoneCounter : public EventListener {
+    mutable mutex mu;
+    map<string, int64_t> by_cf;
+    bool loaded = false;
+
+    void add(const string &cf_name, int64_t delta) {
+        lock_guard<mutex> lock(mu);
+        if (loaded) {
+            by_cf[cf_name] += delta;
+        }
+    }
+
+public:
+    const char *Name() const override {
+        return "RangeTombstoneCounter";
+    }
+
+    void OnFlushCompleted(DB *, const FlushJobInfo &info) override {
+        add(info.cf_name, static_cast<int64_t>(info.table_properties.num_range_deletions));
+    }
+
+    void OnCompactionCompleted(DB *, const CompactionJobInfo &info) override {
+        if (!info.status.ok()) {
+            return;
+        }
+        auto count_of = [&info](const string &path) -> int64_t {
+            auto it = info.table_properties.find(path);
+            return it == info.table_properties.end() ? 0 : static_cast<int64_t>(it->second->num_range_deletions);
+        };
+        int64_t delta = 0;
+        for (auto &path: info.output_files) {
+            delta += count_of(path);
+        }
+        for (auto &path: info.input_files) {
+            delta -= count_of(path);
+        }
+        add(info.cf_name, delta);
+    }
+
+    void OnExternalFileIngested(DB *, const ExternalFileIngestionInfo &info) override {
+        add(info.cf_name, static_cast<int64_t>(info.table_properties.num_range_deletions));
+    }
+
+    // Counts the tombstones of `cf` from the properties of all its files, and starts tracking changes.
+    inline Status reload(DB *db, ColumnFamilyHandle *cf) {
+        lock_guard<mutex> lock(mu);
+        TablePropertiesCollection props;
+        auto s = db->GetPropertiesOfAllTables(cf, &props);
+        if (!s.ok()) {
+            return s;
+        }
+        int64_t count = 0;
+        for (auto &pair: props) {
+            count += static_cast<int64_t>(pair.second->num_range_deletions);
+        }
+        by_cf[cf->GetName()] = count;
+        loaded = true;
+        return s;
+    }
+
+    inline void forget(const string &cf_name) {
+        lock_guard<mutex> lock(mu);
+        by_cf.erase(cf_name);
+    }
+
+    [[nodiscard]] inline uint64_t total() const {
+        lock_guard<mutex> lock(mu);
+        int64_t ret = 0;
+        for (auto &pair: by_cf) {
+            ret += pair.second;
+        }
+        return ret > 0 ? static_cast<uint64_t>(ret) : 0;
+    }
+};
+
+#endif //COZOROCKS_TABLE_STATS_H
@@ -16,4 +16,33 @@ void TxBridge::start() {
         tx.reset(txn);
     }
     assert(tx);
-}
\ No newline at end of file
+}
+
+void TxBridge::multi_get(RustBytes keys, rust::Slice<const size_t> key_offsets, bool for_update, bool with_values,
+                         rust::Vec<uint8_t> &vals, rust::Vec<size_t> &val_offsets, rust::Vec<bool> &found,
+                         RocksDbStatus &status) const {
+    auto key_slices = unpack_keys(keys, key_offsets);
+    auto n = key_slices.size();
+
+    // Point lookups of a join usually all hit the same relation, and thus the same column family
+    vector<ColumnFamilyHandle *> key_cfs;
+    key_cfs.reserve(n);
+    bool single_cf = true;
+    for (auto &k: key_slices) {
+        key_cfs.push_back(cfs->for_key(k));
+        single_cf = single_cf && key_cfs.back() == key_cfs.front();
+    }
+
+    if (for_update || !single_cf) {
+        vector<string> values;
+        auto statuses = for_update ? tx->MultiGetForUpdate(*r_opts, key_cfs, key_slices, &values)
+                                   : tx->MultiGet(*r_opts, key_cfs, key_slices, &values);
+        pack_multi_get_results(statuses, values, with_values, vals, val_offsets, found, status);
+    } else {
+        vector<PinnableSlice> values(n);
+        vector<Status> statuses(n);
+        auto cf = n == 0 ? cfs->default_cf : key_cfs.front();
+        tx->MultiGet(*r_opts, cf, n, key_slices.data(), values.data(), statuses.data());
+        pack_multi_get_results(statuses, values, with_values, vals, val_offsets, found, status);
+    }
+}
@@ -11,6 +11,54 @@
 #include "slice.h"
 #include "status.h"
 #include "iter.h"
+#include "cf.h"
+
+// Splits keys packed back-to-back in `keys`, where `key_offsets` holds the end offset of each key.
+inline vector<Slice> unpack_keys(RustBytes keys, rust::Slice<const size_t> key_offsets) {
+    vector<Slice> key_slices;
+    key_slices.reserve(key_offsets.size());
+    auto keys_data = reinterpret_cast<const char *>(keys.data());
+    size_t start = 0;
+    for (auto end: key_offsets) {
+        key_slices.emplace_back(keys_data + start, end - start);
+        start = end;
+    }
+    return key_slices;
+}
+
+// Packs the results of a multi-get in the layout described at `TxBridge::multi_get`,
+// stopping at the first status other than OK or NotFound. Values are gathered on this side first,
+// so that they cross over to Rust in one copy. Without `with_values`, only `found` is filled.
+template<typename V>
+inline void pack_multi_get_results(const vector<Status> &statuses, const vector<V> &values, bool with_values,
+                                   rust::Vec<uint8_t> &vals, rust::Vec<size_t> &val_offsets,
+                                   rust::Vec<bool> &found, RocksDbStatus &status) {
+    vals.clear();
+    val_offsets.clear();
+    found.clear();
+    found.reserve(statuses.size());
+    string packed;
+    vector<size_t> ends;
+    for (size_t i = 0; i < statuses.size(); ++i) {
+        if (statuses[i].ok()) {
+            if (with_values) {
+                packed.append(values[i].data(), values[i].size());
+            }
+            found.push_back(true);
+        } else if (statuses[i].IsNotFound()) {
+            found.push_back(false);
+        } else {
+            write_status(statuses[i], status);
+            return;
+        }
+        if (with_values) {
+            ends.push_back(packed.size());
+        }
+    }
+    append_to_rust_vec(vals, packed);
+    append_to_rust_vec(val_offsets, ends);
+    write_status(Status::OK(), status);
+}
 
 struct TxBridge {
     OptimisticTransactionDB *odb;
@@ -20,9 +68,9 @@ struct TxBridge {
     unique_ptr<ReadOptions> r_opts;
     unique_ptr<OptimisticTransactionOptions> o_tx_opts;
     unique_ptr<TransactionOptions> p_tx_opts;
-    ColumnFamilyHandle * cf_handle;
+    shared_ptr<CfRegistry> cfs;
 
-    explicit TxBridge(TransactionDB *tdb_, ColumnFamilyHandle * cf_handle_) :
+    explicit TxBridge(TransactionDB *tdb_, shared_ptr<CfRegistry> cfs_) :
             odb(nullptr),
             tdb(tdb_),
             tx(),
@@ -30,7 +78,19 @@ struct TxBridge {
             r_opts(new ReadOptions),
             o_tx_opts(nullptr),
             p_tx_opts(new TransactionOptions),
-            cf_handle(cf_handle_) {
+            cfs(std::move(cfs_)) {
+        r_opts->ignore_range_deletions = true;
+    }
+
+    explicit TxBridge(OptimisticTransactionDB *odb_, shared_ptr<CfRegistry> cfs_) :
+            odb(odb_),
+            tdb(nullptr),
+            tx(),
+            w_opts(new WriteOptions),
+            r_opts(new ReadOptions),
+            o_tx_opts(new OptimisticTransactionOptions),
+            p_tx_opts(nullptr),
+            cfs(std::move(cfs_)) {
         r_opts->ignore_range_deletions = true;
     }
 
@@ -51,7 +111,7 @@ struct TxBridge {
     }
 
     inline unique_ptr<IterBridge> iterator() const {
-        return make_unique<IterBridge>(&*tx);
+        return make_unique<IterBridge>(&*tx, cfs);
     };
 
     inline void set_snapshot(bool val) {
@@ -82,35 +142,52 @@ struct TxBridge {
 
     inline unique_ptr<PinnableSlice> get(RustBytes key, bool for_update, RocksDbStatus &status) const {
         Slice key_ = convert_slice(key);
+        auto cf = cfs->for_key(key_);
         auto ret = make_unique<PinnableSlice>();
         if (for_update) {
-            auto s = tx->GetForUpdate(*r_opts, cf_handle, key_, &*ret);
+            auto s = tx->GetForUpdate(*r_opts, cf, key_, &*ret);
             write_status(s, status);
         } else {
-            auto s = tx->Get(*r_opts, key_, &*ret);
+            auto s = tx->Get(*r_opts, cf, key_, &*ret);
             write_status(s, status);
         }
         return ret;
     }
 
+    // Keys are packed back-to-back in `keys`, with `key_offsets` holding the end offset of each key.
+    // Found values are appended to `vals`, with the end offset of each value pushed to `val_offsets`;
+    // missing keys are marked in `found` and contribute an empty value. Without `with_values`,
+    // only `found` is filled.
+    void multi_get(RustBytes keys, rust::Slice<const size_t> key_offsets, bool for_update, bool with_values,
+                   rust::Vec<uint8_t> &vals, rust::Vec<size_t> &val_offsets, rust::Vec<bool> &found,
+                   RocksDbStatus &status) const;
+
     inline void exists(RustBytes key, bool for_update, RocksDbStatus &status) const {
         Slice key_ = convert_slice(key);
+        auto cf = cfs->for_key(key_);
         auto ret = PinnableSlice();
         if (for_update) {
-            auto s = tx->GetForUpdate(*r_opts, cf_handle, key_, &ret);
+            auto s = tx->GetForUpdate(*r_opts, cf, key_, &ret);
             write_status(s, status);
         } else {
-            auto s = tx->Get(*r_opts, key_, &ret);
+            auto s = tx->Get(*r_opts, cf, key_, &ret);
             write_status(s, status);
         }
     }
 
     inline void put(RustBytes key, RustBytes val, RocksDbStatus &status) const {
-        write_status(tx->Put(convert_slice(key), convert_slice(val)), status);
+        Slice key_ = convert_slice(key);
+        write_status(tx->Put(cfs->for_key(key_), key_, convert_slice(val)), status);
     }
 
     inline void del(RustBytes key, RocksDbStatus &status) const {
-        write_status(tx->Delete(convert_slice(key)), status);
+        Slice key_ = convert_slice(key);
+        write_status(tx->Delete(cfs->for_key(key_), key_), status);
+    }
+
+    inline void merge(RustBytes key, RustBytes operand, RocksDbStatus &status) const {
+        Slice key_ = convert_slice(key);
+        write_status(tx->Merge(cfs->for_key(key_), key_, convert_slice(operand)), status);
     }
 
     inline void commit(RocksDbStatus &status) {
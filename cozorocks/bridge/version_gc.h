@@ -0,0 +1,123 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_VERSION_GC_H
+#define COZOROCKS_VERSION_GC_H
+
+#include <chrono>
+#include <map>
+#include <shared_mutex>
+#include <mutex>
+
+#include "common.h"
+#include "cf.h"
+
+// Keys of relations with time travel end with their validity, encoded as a tag byte, the timestamp
+// in microseconds (order-encoded, then flipped so that newer versions sort first), and a byte that
+// is 0 for assertions and 1 for retractions.
+static const size_t VALIDITY_SUFFIX_LEN = 10;
+static const uint8_t VALIDITY_TAG = 0x0C;
+
+inline int64_t decode_validity_ts(const char *data) {
+    uint64_t flipped = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        flipped = (flipped << 8) | static_cast<uint8_t>(data[i]);
+    }
+    return static_cast<int64_t>(~flipped ^ 0x8000000000000000ULL);
+}
+
+// How long historical versions are kept, in microseconds, for each relation with a retention set.
+struct RetentionRegistry {
+    map<uint64_t, int64_t> by_id;
+    mutable shared_mutex mutex;
+
+    inline void set(uint64_t id, int64_t retention_micros) {
+        unique_lock lock(mutex);
+        by_id[id] = retention_micros;
+    }
+
+    inline void clear(uint64_t id) {
+        unique_lock lock(mutex);
+        by_id.erase(id);
+    }
+
+    // The horizon of each relation at `now_micros`: versions at or before it are no longer needed
+    // except for the newest one.
+    inline map<uint64_t, int64_t> horizons(int64_t now_micros) const {
+        shared_lock lock(mutex);
+        map<uint64_t, int64_t> ret;
+        for (auto &pair: by_id) {
+            ret[pair.first] = now_micros - pair.second;
+        }
+        return ret;
+    }
+};
+
+// Drops versions of a row that are superseded at the retention horizon of its relation. Keys arrive
+// in order, so the versions of a row are seen newest first: every version after the horizon is kept,
+// as is the first one at or before it, which is the state of the row as of the horizon. Older ones
+// are dropped. A row whose newer versions are not part of this compaction keeps its versions here.
+class VersionGcFilter : public CompactionFilter {
+    map<uint64_t, int64_t> horizons;
+    mutable string kept_key;
+    mutable size_t kept_row_len;
+
+public:
+    explicit VersionGcFilter(map<uint64_t, int64_t> horizons_) : horizons(std::move(horizons_)),
+                                                                 kept_key(), kept_row_len(0) {}
+
+    bool Filter(int, const Slice &key, const Slice &, string *, bool *) const override {
+        if (key.size() < RELATION_PREFIX_LEN + VALIDITY_SUFFIX_LEN) {
+            return false;
+        }
+        auto it = horizons.find(decode_relation_prefix(key));
+        if (it == horizons.end()) {
+            return false;
+        }
+        size_t row_len = key.size() - VALIDITY_SUFFIX_LEN;
+        if (static_cast<uint8_t>(key[row_len]) != VALIDITY_TAG) {
+            return false;
+        }
+        if (decode_validity_ts(key.data() + row_len + 1) > it->second) {
+            return false;
+        }
+        bool same_row = kept_row_len == row_len && Slice(kept_key.data(), row_len) == Slice(key.data(), row_len);
+        // A key may be seen more than once when snapshots hold older entries of it
+        if (same_row && Slice(kept_key) != key) {
+            return true;
+        }
+        kept_key.assign(key.data(), key.size());
+        kept_row_len = row_len;
+        return false;
+    }
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoVersionGcFilter";
+    }
+};
+
+class VersionGcFilterFactory : public CompactionFilterFactory {
+    shared_ptr<RetentionRegistry> retention;
+
+public:
+    explicit VersionGcFilterFactory(shared_ptr<RetentionRegistry> retention_) : retention(std::move(retention_)) {}
+
+    unique_ptr<CompactionFilter> CreateCompactionFilter(const CompactionFilter::Context &) override {
+        auto now = chrono::duration_cast<chrono::microseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+        auto horizons = retention->horizons(now);
+        if (horizons.empty()) {
+            return nullptr;
+        }
+        return make_unique<VersionGcFilter>(std::move(horizons));
+    }
+
+    [[nodiscard]] const char *Name() const override {
+        return "CozoVersionGcFilterFactory";
+    }
+};
+
+#endif //COZOROCKS_VERSION_GC_H
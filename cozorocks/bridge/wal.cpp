@@ -0,0 +1,90 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "wal.h"
+#include "cozorocks/src/bridge/mod.rs.h"
+
+// Turns the operations of a write batch into entries, one sequence number each. Only batches
+// written under WRITE_COMMITTED are read this way: under the other policies, the log holds
+// writes of transactions before they commit or roll back, and sequence numbers are per batch.
+class WalEntryCollector : public WriteBatch::Handler {
+    rust::Vec<WalEntry> &entries;
+    SequenceNumber seq;
+
+    void push(uint8_t op, const Slice &key, const Slice &value) {
+        WalEntry entry;
+        entry.seq = seq++;
+        entry.op = op;
+        append_to_rust_vec(entry.key, key);
+        append_to_rust_vec(entry.value, value);
+        entries.push_back(std::move(entry));
+    }
+
+public:
+    WalEntryCollector(rust::Vec<WalEntry> &entries_, SequenceNumber seq_) : entries(entries_), seq(seq_) {}
+
+    Status PutCF(uint32_t, const Slice &key, const Slice &value) override {
+        push(WAL_OP_PUT, key, value);
+        return Status::OK();
+    }
+
+    Status DeleteCF(uint32_t, const Slice &key) override {
+        push(WAL_OP_DELETE, key, Slice());
+        return Status::OK();
+    }
+
+    Status SingleDeleteCF(uint32_t, const Slice &key) override {
+        push(WAL_OP_DELETE, key, Slice());
+        return Status::OK();
+    }
+
+    Status MergeCF(uint32_t, const Slice &key, const Slice &value) override {
+        push(WAL_OP_MERGE, key, value);
+        return Status::OK();
+    }
+
+    Status DeleteRangeCF(uint32_t, const Slice &begin_key, const Slice &end_key) override {
+        push(WAL_OP_DELETE_RANGE, begin_key, end_key);
+        return Status::OK();
+    }
+
+    Status MarkBeginPrepare(bool) override {
+        return Status::OK();
+    }
+
+    Status MarkEndPrepare(const Slice &) override {
+        return Status::OK();
+    }
+
+    Status MarkCommit(const Slice &) override {
+        return Status::OK();
+    }
+
+    Status MarkRollback(const Slice &) override {
+        return Status::OK();
+    }
+
+    Status MarkNoop(bool) override {
+        return Status::OK();
+    }
+};
+
+bool WalIterBridge::next_batch(rust::Vec<WalEntry> &entries, RocksDbStatus &status) {
+    if (iter == nullptr || !iter->Valid()) {
+        write_status(iter == nullptr ? Status::OK() : iter->status(), status);
+        return false;
+    }
+    auto batch = iter->GetBatch();
+    WalEntryCollector collector(entries, batch.sequence);
+    auto s = batch.writeBatchPtr->Iterate(&collector);
+    if (!s.ok()) {
+        write_status(s, status);
+        return false;
+    }
+    iter->Next();
+    write_status(Status::OK(), status);
+    return true;
+}
@@ -0,0 +1,31 @@
+// Copyright 2022, The Cozo Project Authors.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+// If a copy of the MPL was not distributed with this file,
+// You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef COZOROCKS_WAL_H
+#define COZOROCKS_WAL_H
+
+#include "common.h"
+#include "slice.h"
+#include "status.h"
+#include "rocksdb/transaction_log.h"
+
+// Values of `WalEntry::op`
+static const uint8_t WAL_OP_PUT = 0;
+static const uint8_t WAL_OP_DELETE = 1;
+static const uint8_t WAL_OP_MERGE = 2;
+// The key and value of the entry are the start and end of the deleted range
+static const uint8_t WAL_OP_DELETE_RANGE = 3;
+
+// Reads the write batches in the write-ahead log from a sequence number on, as of when it was created.
+struct WalIterBridge {
+    unique_ptr<TransactionLogIterator> iter;
+
+    // Appends the entries of the next write batch to `entries`. Each entry gets the sequence number of
+    // the batch plus its position in the batch. Returns false when there are no more batches.
+    bool next_batch(rust::Vec<WalEntry> &entries, RocksDbStatus &status);
+};
+
+#endif //COZOROCKS_WAL_H
@@ -15,7 +15,14 @@ fn main() {
 
     let mut builder = cxx_build::bridge("src/bridge/mod.rs");
     builder
-        .files(["bridge/status.cpp", "bridge/db.cpp", "bridge/tx.cpp"])
+        .files([
+            "bridge/status.cpp",
+            "bridge/slice.cpp",
+            "bridge/db.cpp",
+            "bridge/tx.cpp",
+            "bridge/backup.cpp",
+            "bridge/wal.cpp",
+        ])
         .include(rocksdb_include_dir())
         .include("bridge");
     if target.contains("msvc") {
@@ -75,12 +82,22 @@ fn main() {
     println!("cargo:rerun-if-changed=bridge/db.h");
     println!("cargo:rerun-if-changed=bridge/db.cpp");
     println!("cargo:rerun-if-changed=bridge/slice.h");
+    println!("cargo:rerun-if-changed=bridge/slice.cpp");
     println!("cargo:rerun-if-changed=bridge/status.h");
     println!("cargo:rerun-if-changed=bridge/status.cpp");
     println!("cargo:rerun-if-changed=bridge/opts.h");
     println!("cargo:rerun-if-changed=bridge/iter.h");
+    println!("cargo:rerun-if-changed=bridge/cf.h");
+    println!("cargo:rerun-if-changed=bridge/version_gc.h");
+    println!("cargo:rerun-if-changed=bridge/merge.h");
+    println!("cargo:rerun-if-changed=bridge/table_stats.h");
+    println!("cargo:rerun-if-changed=bridge/partitioner.h");
     println!("cargo:rerun-if-changed=bridge/tx.h");
     println!("cargo:rerun-if-changed=bridge/tx.cpp");
+    println!("cargo:rerun-if-changed=bridge/backup.h");
+    println!("cargo:rerun-if-changed=bridge/backup.cpp");
+    println!("cargo:rerun-if-changed=bridge/wal.h");
+    println!("cargo:rerun-if-changed=bridge/wal.cpp");
 
     if !Path::new("rocksdb/AUTHORS").exists() {
         update_submodules();
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022, The Cozo Project Authors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+use crate::bridge::ffi;
+use crate::bridge::ffi::*;
+
+/// The backups kept in `opts.backup_dir`, oldest first.
+pub fn list_backups(opts: &BackupOpts) -> Result<Vec<BackupEntry>, RocksDbStatus> {
+    let mut status = RocksDbStatus::default();
+    let mut entries = vec![];
+    ffi::list_backups(opts, &mut entries, &mut status);
+    if status.is_ok() {
+        Ok(entries)
+    } else {
+        Err(status)
+    }
+}
+
+/// Check that the files of a backup are intact.
+pub fn verify_backup(opts: &BackupOpts, backup_id: u32) -> Result<(), RocksDbStatus> {
+    let mut status = RocksDbStatus::default();
+    ffi::verify_backup(opts, backup_id, &mut status);
+    if status.is_ok() {
+        Ok(())
+    } else {
+        Err(status)
+    }
+}
+
+/// Restore a backup, or the latest one if `backup_id` is `None`, into the directory `db_dir`,
+/// replacing the database files there. The database must not be open.
+pub fn restore_backup(
+    opts: &BackupOpts,
+    backup_id: Option<u32>,
+    db_dir: &str,
+) -> Result<(), RocksDbStatus> {
+    let mut status = RocksDbStatus::default();
+    ffi::restore_backup(opts, backup_id.unwrap_or(0), db_dir, &mut status);
+    if status.is_ok() {
+        Ok(())
+    } else {
+        Err(status)
+    }
+}
@@ -10,7 +10,9 @@ use cxx::*;
 use std::path::Path;
 
 use crate::bridge::ffi::*;
+use crate::bridge::snapshot::DbSnapshot;
 use crate::bridge::tx::TxBuilder;
+use crate::bridge::wal::WalIter;
 
 #[derive(Default, Clone)]
 pub struct DbBuilder {
@@ -54,6 +56,34 @@ impl Default for DbOpts {
             fixed_prefix_extractor_len: 0,
             destroy_on_exit: false,
             block_cache_size: 0,
+            use_hyper_clock_cache: false,
+            row_cache_size: 0,
+            enable_statistics: false,
+            optimistic: false,
+            lock_stripes: 16,
+            lock_timeout_ms: 1000,
+            max_num_locks: -1,
+            deadlock_detect: false,
+            deadlock_detect_depth: 50,
+            write_policy: String::new(),
+            write_batch_flush_threshold: 0,
+            enable_pipelined_write: false,
+            allow_concurrent_memtable_write: true,
+            unordered_write: false,
+            write_buffer_size: 0,
+            max_write_buffer_number: 0,
+            write_buffer_manager_size: 0,
+            partition_index_filters: false,
+            use_ribbon_filter: false,
+            optimize_filters_for_memory: false,
+            sst_partition_prefix_len: 0,
+            max_file_opening_threads: 0,
+            skip_stats_update_on_db_open: false,
+            skip_checking_sst_file_sizes_on_db_open: false,
+            secondary_path: vec![],
+            read_only: false,
+            wal_ttl_seconds: 0,
+            wal_size_limit_mb: 0,
         }
     }
 }
@@ -67,6 +97,26 @@ impl DbBuilder {
         self.opts.options_path = path2buf(path);
         self
     }
+    /// Keep write-ahead log files for at least `ttl_seconds`, or until they take up more than
+    /// `size_limit_mb` together, so that [RocksDb::updates_since] can read them. Zeros delete
+    /// them as soon as their data is flushed.
+    pub fn wal_retention(mut self, ttl_seconds: u64, size_limit_mb: u64) -> Self {
+        self.opts.wal_ttl_seconds = ttl_seconds;
+        self.opts.wal_size_limit_mb = size_limit_mb;
+        self
+    }
+    /// Open the database at `path` as a read-only secondary instance, which keeps its own
+    /// files in the directory `secondary_path`. The primary may keep running.
+    pub fn secondary_path(mut self, secondary_path: impl AsRef<Path>) -> Self {
+        self.opts.secondary_path = path2buf(secondary_path);
+        self
+    }
+    /// Open the database at `path` read-only. Nothing is written to its directory, and no lock
+    /// is taken, so it may be open elsewhere at the same time.
+    pub fn read_only(mut self, val: bool) -> Self {
+        self.opts.read_only = val;
+        self
+    }
     pub fn prepare_for_bulk_load(mut self, val: bool) -> Self {
         self.opts.prepare_for_bulk_load = val;
         self
@@ -111,6 +161,31 @@ impl DbBuilder {
         self.opts.bloom_filter_whole_key_filtering = whole_key_filtering;
         self
     }
+    /// Split index and filter blocks into partitions, loaded into the block cache as needed,
+    /// with only a small top-level index pinned. Keeps large databases from filling the cache
+    /// with index and filter blocks.
+    pub fn partition_index_filters(mut self, val: bool) -> Self {
+        self.opts.partition_index_filters = val;
+        self
+    }
+    /// Use Ribbon filters instead of Bloom filters, which take about 30% less space for the same
+    /// false positive rate, at a higher CPU cost to build. `bits_per_key` of
+    /// [use_bloom_filter](Self::use_bloom_filter) then gives the equivalent Bloom filter size.
+    pub fn use_ribbon_filter(mut self, val: bool) -> Self {
+        self.opts.use_ribbon_filter = val;
+        self
+    }
+    /// Size filters to fit the allocator, reducing memory lost to internal fragmentation.
+    pub fn optimize_filters_for_memory(mut self, val: bool) -> Self {
+        self.opts.optimize_filters_for_memory = val;
+        self
+    }
+    /// Cut compaction output files where the first `len` bytes of keys change, so that files do
+    /// not mix keys of different prefixes. Zero disables partitioning.
+    pub fn sst_partition_prefix_len(mut self, len: usize) -> Self {
+        self.opts.sst_partition_prefix_len = len;
+        self
+    }
     pub fn use_capped_prefix_extractor(mut self, enable: bool, len: usize) -> Self {
         self.opts.use_capped_prefix_extractor = enable;
         self.opts.capped_prefix_extractor_len = len;
@@ -121,6 +196,103 @@ impl DbBuilder {
         self.opts.fixed_prefix_extractor_len = len;
         self
     }
+    /// Use a shared block cache of the given size in bytes, either LRU or HyperClockCache.
+    /// A size of zero keeps the RocksDB default cache.
+    pub fn block_cache(mut self, size: usize, hyper_clock: bool) -> Self {
+        self.opts.block_cache_size = size;
+        self.opts.use_hyper_clock_cache = hyper_clock;
+        self
+    }
+    /// Use a row cache of the given size in bytes. A size of zero disables the row cache.
+    pub fn row_cache(mut self, size: usize) -> Self {
+        self.opts.row_cache_size = size;
+        self
+    }
+    /// Collect statistics, which are required for cache hit and miss counters.
+    pub fn enable_statistics(mut self, val: bool) -> Self {
+        self.opts.enable_statistics = val;
+        self
+    }
+    /// Open as an `OptimisticTransactionDB`: transactions take no locks, and conflicts are
+    /// detected when committing instead.
+    pub fn optimistic(mut self, val: bool) -> Self {
+        self.opts.optimistic = val;
+        self
+    }
+    /// Number of stripes of the lock table of each column family, for pessimistic transactions.
+    pub fn lock_stripes(mut self, val: usize) -> Self {
+        self.opts.lock_stripes = val;
+        self
+    }
+    /// How long a pessimistic transaction waits for a lock, in milliseconds, before failing
+    /// with a lock timeout. Negative values wait forever, zero does not wait at all.
+    pub fn lock_timeout_ms(mut self, val: i64) -> Self {
+        self.opts.lock_timeout_ms = val;
+        self
+    }
+    /// Maximum number of keys locked at once in each column family. Negative means unlimited.
+    pub fn max_num_locks(mut self, val: i64) -> Self {
+        self.opts.max_num_locks = val;
+        self
+    }
+    /// Detect deadlocks between pessimistic transactions, following wait-for edges up to
+    /// `depth` deep, and fail one of them immediately instead of letting it time out.
+    pub fn deadlock_detect(mut self, enable: bool, depth: i64) -> Self {
+        self.opts.deadlock_detect = enable;
+        self.opts.deadlock_detect_depth = depth;
+        self
+    }
+    /// When pessimistic transactions write their data to the memtable: `committed` (the default)
+    /// buffers it in the transaction until commit, `prepared` writes it on commit but publishes
+    /// it separately, and `unprepared` also writes it out while the transaction is running,
+    /// whenever its buffer exceeds `flush_threshold` bytes.
+    /// Switching the policy of an existing database requires its write-ahead log to be empty.
+    pub fn write_policy(mut self, policy: &str, flush_threshold: i64) -> Self {
+        self.opts.write_policy = policy.to_string();
+        self.opts.write_batch_flush_threshold = flush_threshold;
+        self
+    }
+    /// Threads opening SST files when the database is opened. Zero keeps the RocksDB default.
+    pub fn max_file_opening_threads(mut self, threads: i32) -> Self {
+        self.opts.max_file_opening_threads = threads;
+        self
+    }
+    /// Skip work done on open that reads every SST file: loading file statistics used for
+    /// compaction decisions, and checking the sizes of files against the manifest.
+    pub fn skip_open_checks(mut self, skip_stats_update: bool, skip_file_size_check: bool) -> Self {
+        self.opts.skip_stats_update_on_db_open = skip_stats_update;
+        self.opts.skip_checking_sst_file_sizes_on_db_open = skip_file_size_check;
+        self
+    }
+    /// Let writers of a write group proceed to the memtable while the next group writes the WAL.
+    pub fn enable_pipelined_write(mut self, val: bool) -> Self {
+        self.opts.enable_pipelined_write = val;
+        self
+    }
+    /// Let concurrent writers insert into the memtable in parallel.
+    pub fn allow_concurrent_memtable_write(mut self, val: bool) -> Self {
+        self.opts.allow_concurrent_memtable_write = val;
+        self
+    }
+    /// Skip ordering memtable writes after the WAL, for higher write throughput.
+    /// Only available with the `prepared` write policy, which keeps transactions consistent.
+    pub fn unordered_write(mut self, val: bool) -> Self {
+        self.opts.unordered_write = val;
+        self
+    }
+    /// Size in bytes of each memtable, and how many may exist for a column family before writes
+    /// stall. Zeros keep the RocksDB defaults.
+    pub fn write_buffers(mut self, size: usize, max_number: usize) -> Self {
+        self.opts.write_buffer_size = size;
+        self.opts.max_write_buffer_number = max_number;
+        self
+    }
+    /// Bound the memory of the memtables of all column families together, in bytes.
+    /// Zero leaves them unbounded.
+    pub fn write_buffer_manager(mut self, size: usize) -> Self {
+        self.opts.write_buffer_manager_size = size;
+        self
+    }
     pub fn build(self) -> Result<RocksDb, RocksDbStatus> {
         let mut status = RocksDbStatus::default();
 
@@ -147,6 +319,32 @@ impl RocksDb {
             inner: self.inner.transact(),
         }
     }
+    /// Take a snapshot for reading without a transaction.
+    pub fn snapshot(&self) -> DbSnapshot {
+        DbSnapshot {
+            inner: self.inner.snapshot(),
+        }
+    }
+    /// Create a batch of puts applied to the database directly, bypassing transactions.
+    /// When `disable_wal` is true, the writes skip the write-ahead log, and are only durable
+    /// after a call to [RocksDb::flush].
+    pub fn write_batch(&self, disable_wal: bool) -> WriteBatch {
+        let mut inner = self.inner.write_batch();
+        inner.pin_mut().disable_wal(disable_wal);
+        WriteBatch { inner }
+    }
+    /// Flush the memtables of all column families to disk.
+    pub fn flush(&self) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.flush(&mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+    /// Delete all keys in `[lower, upper)` with a range tombstone. Reads ignore range tombstones,
+    /// so the keys must already be deleted, or the range never read again.
     #[inline]
     pub fn range_del(&self, lower: &[u8], upper: &[u8]) -> Result<(), RocksDbStatus> {
         let mut status = RocksDbStatus::default();
@@ -157,6 +355,41 @@ impl RocksDb {
             Err(status)
         }
     }
+    /// Take a backup with the RocksDB backup engine, copying only the SST files that earlier
+    /// backups in `opts.backup_dir` do not have. Returns the id of the new backup.
+    pub fn create_backup(&self, opts: &BackupOpts) -> Result<u32, RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        let backup_id = create_backup(&self.inner, opts, &mut status);
+        if status.is_ok() {
+            Ok(backup_id)
+        } else {
+            Err(status)
+        }
+    }
+    /// Create a consistent copy of the database in the directory `path`, which must not exist,
+    /// by hard-linking its SST files and copying the rest. It can be opened like the original.
+    pub fn create_checkpoint(&self, path: &str) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.create_checkpoint(path, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+    /// Delete all keys in `[lower, upper)`, which must not span column families and must already
+    /// be deleted key by key, with a range tombstone, and drop the files of the range at once if
+    /// none of them reaches out of the range and no snapshot is open. Otherwise compactions
+    /// reclaim them.
+    pub fn range_drop(&self, lower: &[u8], upper: &[u8]) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.drop_range(lower, upper, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
     #[inline]
     pub fn raw_put(&self, key: &[u8], val: &[u8]) -> Result<(), RocksDbStatus> {
         let mut status = RocksDbStatus::default();
@@ -177,18 +410,187 @@ impl RocksDb {
             Err(status)
         }
     }
-    pub fn get_sst_writer(&self, path: &str) -> Result<SstWriter, RocksDbStatus> {
+    /// Number of range tombstones in SST files, which compactions have yet to clear.
+    ///
+    /// The count is kept up to date as files are added and removed, so this does not go through
+    /// the properties of every file.
+    pub fn range_tombstone_count(&self) -> u64 {
+        self.inner.range_tombstone_count()
+    }
+    /// Create the column family holding the relation with the given id.
+    /// Keys of the relation written afterwards go there instead of the default column family.
+    pub fn create_relation_cf(&self, id: u64, opts: &CfOpts) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.create_relation_cf(id, opts, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+    /// Drop the column family of the relation with the given id, along with all its data.
+    /// Does nothing if the relation has no column family of its own.
+    pub fn drop_relation_cf(&self, id: u64) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.drop_relation_cf(id, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+    /// Ids of the relations having their own column families, in ascending order.
+    pub fn relation_cf_ids(&self) -> Vec<u64> {
+        self.inner.relation_cf_ids()
+    }
+    /// Let compactions drop versions of the relation with the given id that are older than
+    /// `retention_micros`, keeping the newest version of each row at that point, or stop doing so
+    /// if `None` is given. Only meaningful for relations whose last key column is a validity.
+    pub fn set_relation_retention(&self, id: u64, retention_micros: Option<i64>) {
+        match retention_micros {
+            Some(micros) => self.inner.set_relation_retention(id, micros),
+            None => self.inner.clear_relation_retention(id),
+        }
+    }
+    /// Approximate statistics of the keys in `[lower, upper)`, which must not span column families.
+    /// Cheap, as no keys are read.
+    pub fn approximate_range_stats(&self, lower: &[u8], upper: &[u8]) -> RangeStats {
+        let mut stats = RangeStats::default();
+        self.inner.approximate_range_stats(lower, upper, &mut stats);
+        stats
+    }
+    /// Statistics of the relation with the given id, collected when its SST files were written.
+    /// Rows that have not been flushed yet are not counted.
+    pub fn relation_table_stats(&self, id: u64) -> Result<RelationTableStats, RocksDbStatus> {
+        let mut stats = RelationTableStats::default();
+        let mut status = RocksDbStatus::default();
+        self.inner.relation_table_stats(id, &mut stats, &mut status);
+        if status.is_ok() {
+            Ok(stats)
+        } else {
+            Err(status)
+        }
+    }
+    pub fn cache_stats(&self) -> CacheStats {
+        let mut stats = CacheStats::default();
+        self.inner.get_cache_stats(&mut stats);
+        stats
+    }
+    /// Read the write-ahead log from the write batch holding the sequence number `seq` on.
+    pub fn updates_since(&self, seq: u64) -> Result<WalIter, RocksDbStatus> {
         let mut status = RocksDbStatus::default();
-        let ret = self.inner.get_sst_writer(path, &mut status);
+        let ret = self.inner.updates_since(seq, &mut status);
+        if status.is_ok() {
+            Ok(WalIter { inner: ret })
+        } else {
+            Err(status)
+        }
+    }
+    /// The sequence number of the last write.
+    pub fn latest_sequence_number(&self) -> u64 {
+        self.inner.latest_sequence_number()
+    }
+    /// Whether the database was opened as a read-only secondary instance, in which case
+    /// reads go through snapshots and transactions cannot be started.
+    pub fn is_secondary(&self) -> bool {
+        self.inner.is_secondary()
+    }
+    /// Whether the database was opened read-only, either by [DbBuilder::read_only] or as a
+    /// secondary instance. Writes then fail.
+    pub fn is_read_only(&self) -> bool {
+        self.inner.is_read_only()
+    }
+    /// Apply the changes the primary made since the secondary instance was opened or last
+    /// caught up. Relations created by the primary in their own column families in the meantime
+    /// only become visible when the secondary is reopened.
+    pub fn try_catch_up_with_primary(&self) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.try_catch_up_with_primary(&mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+    pub fn open_timings(&self) -> OpenTimings {
+        let mut timings = OpenTimings::default();
+        self.inner.get_open_timings(&mut timings);
+        timings
+    }
+    /// Create a writer of a sorted SST file holding keys of the relation with the given id,
+    /// using the options of the column family the relation lives in.
+    pub fn get_sst_writer(&self, path: &str, relation_id: u64) -> Result<SstWriter, RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        let ret = self.inner.get_sst_writer(path, relation_id, &mut status);
         if status.is_ok() {
             Ok(SstWriter { inner: ret })
         } else {
             Err(status)
         }
     }
-    pub fn ingest_sst_file(&self, path: &str) -> Result<(), RocksDbStatus> {
+    /// Atomically ingest SST files written by [SstWriter], moving them into the database.
+    /// `relation_ids` holds the relation id each file was created for.
+    /// Files for the same column family must not overlap.
+    pub fn ingest_sst_files(
+        &self,
+        paths: &[std::string::String],
+        relation_ids: &[u64],
+    ) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.ingest_ssts(paths, relation_ids, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+}
+
+/// Start counting the work RocksDB does on the calling thread.
+pub fn perf_start() {
+    start_perf_context()
+}
+
+/// Stop counting, and return what was counted on the calling thread since [perf_start].
+pub fn perf_stop() -> PerfStats {
+    let mut stats = PerfStats::default();
+    stop_perf_context(&mut stats);
+    stats
+}
+
+pub struct WriteBatch {
+    inner: UniquePtr<WriteBatchBridge>,
+}
+
+impl WriteBatch {
+    #[inline]
+    pub fn put(&mut self, key: &[u8], val: &[u8]) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.pin_mut().put(key, val, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
+    /// Number of puts accumulated since the last commit.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.inner.count()
+    }
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+    /// Size in bytes of the accumulated puts.
+    #[inline]
+    pub fn data_size(&self) -> usize {
+        self.inner.data_size()
+    }
+    /// Write the accumulated puts atomically. The batch is empty and reusable afterwards.
+    pub fn commit(&mut self) -> Result<(), RocksDbStatus> {
         let mut status = RocksDbStatus::default();
-        self.inner.ingest_sst(path, &mut status);
+        self.inner.pin_mut().commit(&mut status);
         if status.is_ok() {
             Ok(())
         } else {
@@ -18,6 +18,43 @@ pub struct DbIter {
     pub(crate) inner: UniquePtr<IterBridge>,
 }
 
+/// Rows fetched from an iterator in one go, stored contiguously.
+#[derive(Default)]
+pub struct RowBatch {
+    buf: Vec<u8>,
+    offsets: Vec<usize>,
+}
+
+impl RowBatch {
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.offsets.len().saturating_sub(1) / 2
+    }
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+    /// Key and value of the `i`-th row. Panics if out of bounds.
+    #[inline]
+    pub fn get(&self, i: usize) -> (&[u8], &[u8]) {
+        let k_start = self.offsets[2 * i];
+        let k_end = self.offsets[2 * i + 1];
+        let v_end = self.offsets[2 * i + 2];
+        (&self.buf[k_start..k_end], &self.buf[k_end..v_end])
+    }
+}
+
+/// Called from C++ to append a whole buffer at once, instead of going through `push_back`
+/// byte by byte across the FFI boundary.
+pub(crate) fn extend_bytes(buf: &mut Vec<u8>, data: &[u8]) {
+    buf.extend_from_slice(data)
+}
+
+/// Same as [`extend_bytes`], for offsets.
+pub(crate) fn extend_offsets(offsets: &mut Vec<usize>, data: &[usize]) {
+    offsets.extend_from_slice(data)
+}
+
 impl IterBuilder {
     pub fn start(mut self) -> DbIter {
         self.inner.pin_mut().start();
@@ -26,6 +63,11 @@ impl IterBuilder {
     pub fn clear_bounds(&mut self) {
         self.inner.pin_mut().clear_bounds();
     }
+    /// Iterate over the column family holding the relation of `key`.
+    pub fn cf_of(mut self, key: &[u8]) -> Self {
+        self.inner.pin_mut().use_cf_of(key);
+        self
+    }
     pub fn lower_bound(mut self, bound: &[u8]) -> Self {
         self.inner.pin_mut().set_lower_bound(bound);
         self
@@ -141,6 +183,33 @@ impl DbIter {
             }
         }
     }
+    /// Fetch up to `max_rows` rows starting from the current position into `batch`,
+    /// stopping early once `max_bytes` is reached, or at the first key not below `end`
+    /// unless it is empty. The iterator is left positioned after the last row fetched.
+    /// Returns the number of rows fetched, zero meaning exhaustion.
+    #[inline]
+    pub fn next_batch(
+        &mut self,
+        max_rows: usize,
+        max_bytes: usize,
+        end: &[u8],
+        batch: &mut RowBatch,
+    ) -> Result<usize, RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        let n = self.inner.pin_mut().next_batch(
+            max_rows,
+            max_bytes,
+            end,
+            &mut batch.buf,
+            &mut batch.offsets,
+            &mut status,
+        );
+        if status.is_ok() {
+            Ok(n)
+        } else {
+            Err(status)
+        }
+    }
     #[inline]
     pub fn pair(&self) -> Result<Option<(&[u8], &[u8])>, RocksDbStatus> {
         if self.is_valid() {
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2022, The Cozo Project Authors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+use std::panic::catch_unwind;
+use std::sync::OnceLock;
+
+/// Combines the existing value of a key, if any, with merge operands in the order they were written.
+/// Returns `None` if the operands cannot be understood.
+pub type MergeFn = fn(existing: Option<&[u8]>, operands: &[&[u8]]) -> Option<Vec<u8>>;
+
+static MERGE_FN: OnceLock<MergeFn> = OnceLock::new();
+
+/// Set the function used by the merge operator of every database opened in this process.
+/// Only the first call has any effect. Merges fail as corrupted until this is called.
+pub fn set_merge_fn(f: MergeFn) {
+    let _ = MERGE_FN.set(f);
+}
+
+/// Called by the merge operator of the bridge, with operands packed back-to-back in `operands`
+/// and `operand_offsets` holding the end offset of each one.
+pub(crate) fn merge_values(
+    existing: &[u8],
+    has_existing: bool,
+    operands: &[u8],
+    operand_offsets: &[usize],
+    out: &mut Vec<u8>,
+) -> bool {
+    let f = match MERGE_FN.get() {
+        None => return false,
+        Some(f) => f,
+    };
+    let mut unpacked = Vec::with_capacity(operand_offsets.len());
+    let mut start = 0;
+    for &end in operand_offsets {
+        unpacked.push(&operands[start..end]);
+        start = end;
+    }
+    let existing = if has_existing { Some(existing) } else { None };
+    // Panics must not unwind into RocksDB
+    match catch_unwind(|| f(existing, &unpacked)) {
+        Ok(Some(merged)) => {
+            *out = merged;
+            true
+        }
+        _ => false,
+    }
+}
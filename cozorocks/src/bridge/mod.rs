@@ -12,10 +12,16 @@ use std::fmt::{Display, Formatter};
 use miette::{Diagnostic, Severity};
 
 use crate::StatusSeverity;
+use iter::{extend_bytes, extend_offsets};
+use merge::merge_values;
 
+pub(crate) mod backup;
 pub(crate) mod db;
 pub(crate) mod iter;
+pub(crate) mod merge;
+pub(crate) mod snapshot;
 pub(crate) mod tx;
+pub(crate) mod wal;
 
 #[cxx::bridge]
 pub(crate) mod ffi {
@@ -41,6 +47,156 @@ pub(crate) mod ffi {
         pub fixed_prefix_extractor_len: usize,
         pub destroy_on_exit: bool,
         pub block_cache_size: usize,
+        pub use_hyper_clock_cache: bool,
+        pub row_cache_size: usize,
+        pub enable_statistics: bool,
+        pub optimistic: bool,
+        pub lock_stripes: usize,
+        pub lock_timeout_ms: i64,
+        pub max_num_locks: i64,
+        pub deadlock_detect: bool,
+        pub deadlock_detect_depth: i64,
+        pub write_policy: String,
+        pub write_batch_flush_threshold: i64,
+        pub enable_pipelined_write: bool,
+        pub allow_concurrent_memtable_write: bool,
+        pub unordered_write: bool,
+        pub write_buffer_size: usize,
+        pub max_write_buffer_number: usize,
+        pub write_buffer_manager_size: usize,
+        pub partition_index_filters: bool,
+        pub use_ribbon_filter: bool,
+        pub optimize_filters_for_memory: bool,
+        pub sst_partition_prefix_len: usize,
+        pub max_file_opening_threads: i32,
+        pub skip_stats_update_on_db_open: bool,
+        pub skip_checking_sst_file_sizes_on_db_open: bool,
+        pub secondary_path: Vec<u8>,
+        pub read_only: bool,
+        pub wal_ttl_seconds: u64,
+        pub wal_size_limit_mb: u64,
+    }
+
+    /// Options of a column family created for a relation.
+    /// Empty strings and zeros mean the setting is inherited from the database options.
+    #[derive(Debug, Clone, Default)]
+    pub struct CfOpts {
+        pub compression: String,
+        pub compaction_style: String,
+        pub block_size: usize,
+        pub bloom_filter_bits_per_key: f64,
+        pub prefix_len: usize,
+    }
+
+    #[derive(Debug, Clone, Default)]
+    pub struct CacheStats {
+        pub block_cache_capacity: usize,
+        pub block_cache_usage: usize,
+        pub block_cache_pinned_usage: usize,
+        pub row_cache_capacity: usize,
+        pub row_cache_usage: usize,
+        pub statistics_enabled: bool,
+        pub block_cache_hit: u64,
+        pub block_cache_miss: u64,
+        pub block_cache_index_hit: u64,
+        pub block_cache_index_miss: u64,
+        pub block_cache_filter_hit: u64,
+        pub block_cache_filter_miss: u64,
+        pub block_cache_data_hit: u64,
+        pub block_cache_data_miss: u64,
+        pub row_cache_hit: u64,
+        pub row_cache_miss: u64,
+    }
+
+    /// Time spent in the stages of opening the database, in microseconds.
+    #[derive(Debug, Clone, Default)]
+    pub struct OpenTimings {
+        /// Reading the options file and the persisted options of column families
+        pub load_options_micros: u64,
+        /// Opening the database: reading the manifest, opening SST files, replaying the WAL
+        pub open_micros: u64,
+    }
+
+    /// Approximate statistics of a key range within one column family, and of the column family.
+    #[derive(Debug, Clone, Default)]
+    pub struct RangeStats {
+        /// Approximate bytes of SST files covering the range
+        pub file_bytes: u64,
+        /// Approximate number of memtable entries in the range
+        pub memtable_count: u64,
+        pub memtable_bytes: u64,
+        /// Estimated number of keys of the column family
+        pub cf_num_keys: u64,
+        /// Number of memtable entries of the column family
+        pub cf_memtable_entries: u64,
+        /// Estimated bytes of live data in the SST files of the column family
+        pub cf_live_bytes: u64,
+    }
+
+    /// Statistics of a relation recorded in the properties of the SST files holding it.
+    #[derive(Debug, Clone, Default)]
+    pub struct RelationTableStats {
+        pub num_files: u64,
+        pub num_rows: u64,
+        pub key_bytes: u64,
+        pub value_bytes: u64,
+        /// Approximate number of distinct values of the first key column
+        pub distinct_first_keys: u64,
+    }
+
+    /// Where backups taken with the RocksDB backup engine are kept, and how they are taken.
+    #[derive(Debug, Clone, Default)]
+    pub struct BackupOpts {
+        pub backup_dir: String,
+        /// Threads copying files, zero for the default of one
+        pub threads: i32,
+        /// Bytes per second read or written by backups and restores, zero for unlimited
+        pub rate_limit: u64,
+        /// Older backups are purged after a new one is taken so that this many are left,
+        /// zero to keep all of them
+        pub num_to_keep: u32,
+        /// Verify a new backup once it is taken
+        pub verify: bool,
+        /// Verify the checksums of files, not only their sizes
+        pub verify_checksums: bool,
+    }
+
+    /// A backup taken with the RocksDB backup engine.
+    #[derive(Debug, Clone, Default)]
+    pub struct BackupEntry {
+        pub backup_id: u32,
+        /// Seconds since the Unix epoch
+        pub timestamp: i64,
+        /// Bytes of files, including those shared with other backups
+        pub size: u64,
+        pub number_files: u32,
+    }
+
+    /// An operation read back from the write-ahead log.
+    #[derive(Debug, Clone, Default)]
+    pub struct WalEntry {
+        pub seq: u64,
+        /// One of the `WAL_OP_*` constants
+        pub op: u8,
+        pub key: Vec<u8>,
+        pub value: Vec<u8>,
+    }
+
+    /// Counters of the work RocksDB did on one thread, from its PerfContext and IOStatsContext.
+    #[derive(Debug, Clone, Default)]
+    pub struct PerfStats {
+        pub block_cache_hit_count: u64,
+        pub block_read_count: u64,
+        pub block_read_byte: u64,
+        pub bytes_read: u64,
+        pub get_from_memtable_count: u64,
+        pub seek_count: u64,
+        pub next_count: u64,
+        pub bloom_sst_useful: u64,
+        pub bloom_sst_checked: u64,
+        pub internal_key_skipped_count: u64,
+        pub internal_delete_skipped_count: u64,
+        pub internal_range_del_reseek_count: u64,
     }
 
     #[derive(Clone, Debug, Eq, PartialEq)]
@@ -103,6 +259,18 @@ pub(crate) mod ffi {
         kMaxSeverity,
     }
 
+    extern "Rust" {
+        fn merge_values(
+            existing: &[u8],
+            has_existing: bool,
+            operands: &[u8],
+            operand_offsets: &[usize],
+            out: &mut Vec<u8>,
+        ) -> bool;
+        fn extend_bytes(buf: &mut Vec<u8>, data: &[u8]);
+        fn extend_offsets(offsets: &mut Vec<usize>, data: &[usize]);
+    }
+
     unsafe extern "C++" {
         include!("bridge.h");
 
@@ -120,25 +288,119 @@ pub(crate) mod ffi {
         // type ReadOptions;
 
         pub type SnapshotBridge;
+        fn get(
+            self: &SnapshotBridge,
+            key: &[u8],
+            status: &mut RocksDbStatus,
+        ) -> UniquePtr<PinnableSlice>;
+        fn exists(self: &SnapshotBridge, key: &[u8], status: &mut RocksDbStatus);
+        fn multi_get(
+            self: &SnapshotBridge,
+            keys: &[u8],
+            key_offsets: &[usize],
+            with_values: bool,
+            vals: &mut Vec<u8>,
+            val_offsets: &mut Vec<usize>,
+            found: &mut Vec<bool>,
+            status: &mut RocksDbStatus,
+        );
+        fn iterator(self: &SnapshotBridge) -> UniquePtr<IterBridge>;
 
         type RocksDbBridge;
         fn get_db_path(self: &RocksDbBridge) -> &CxxString;
         fn open_db(builder: &DbOpts, status: &mut RocksDbStatus) -> SharedPtr<RocksDbBridge>;
+        fn start_perf_context();
+        fn stop_perf_context(stats: &mut PerfStats);
+        fn create_backup(db: &RocksDbBridge, opts: &BackupOpts, status: &mut RocksDbStatus) -> u32;
+        fn list_backups(
+            opts: &BackupOpts,
+            entries: &mut Vec<BackupEntry>,
+            status: &mut RocksDbStatus,
+        );
+        fn verify_backup(opts: &BackupOpts, backup_id: u32, status: &mut RocksDbStatus);
+        fn restore_backup(
+            opts: &BackupOpts,
+            backup_id: u32,
+            db_dir: &str,
+            status: &mut RocksDbStatus,
+        );
         fn transact(self: &RocksDbBridge) -> UniquePtr<TxBridge>;
+        fn snapshot(self: &RocksDbBridge) -> UniquePtr<SnapshotBridge>;
+        fn write_batch(self: &RocksDbBridge) -> UniquePtr<WriteBatchBridge>;
+        fn flush(self: &RocksDbBridge, status: &mut RocksDbStatus);
         fn del_range(self: &RocksDbBridge, lower: &[u8], upper: &[u8], status: &mut RocksDbStatus);
         fn put(self: &RocksDbBridge, key: &[u8], val: &[u8], status: &mut RocksDbStatus);
+        fn drop_range(
+            self: &RocksDbBridge,
+            start: &[u8],
+            end: &[u8],
+            status: &mut RocksDbStatus,
+        );
+        fn create_checkpoint(self: &RocksDbBridge, path: &str, status: &mut RocksDbStatus);
         fn compact_range(
             self: &RocksDbBridge,
             lower: &[u8],
             upper: &[u8],
             status: &mut RocksDbStatus,
         );
+        fn range_tombstone_count(self: &RocksDbBridge) -> u64;
         fn get_sst_writer(
             self: &RocksDbBridge,
             path: &str,
+            relation_id: u64,
             status: &mut RocksDbStatus,
         ) -> UniquePtr<SstFileWriterBridge>;
-        fn ingest_sst(self: &RocksDbBridge, path: &str, status: &mut RocksDbStatus);
+        fn ingest_ssts(
+            self: &RocksDbBridge,
+            paths: &[String],
+            relation_ids: &[u64],
+            status: &mut RocksDbStatus,
+        );
+        fn get_cache_stats(self: &RocksDbBridge, stats: &mut CacheStats);
+        fn get_open_timings(self: &RocksDbBridge, timings: &mut OpenTimings);
+        fn is_secondary(self: &RocksDbBridge) -> bool;
+        fn is_read_only(self: &RocksDbBridge) -> bool;
+        fn updates_since(
+            self: &RocksDbBridge,
+            seq: u64,
+            status: &mut RocksDbStatus,
+        ) -> UniquePtr<WalIterBridge>;
+        fn latest_sequence_number(self: &RocksDbBridge) -> u64;
+        fn try_catch_up_with_primary(self: &RocksDbBridge, status: &mut RocksDbStatus);
+        fn approximate_range_stats(
+            self: &RocksDbBridge,
+            start: &[u8],
+            end: &[u8],
+            stats: &mut RangeStats,
+        );
+        fn relation_table_stats(
+            self: &RocksDbBridge,
+            id: u64,
+            stats: &mut RelationTableStats,
+            status: &mut RocksDbStatus,
+        );
+        fn create_relation_cf(
+            self: &RocksDbBridge,
+            id: u64,
+            opts: &CfOpts,
+            status: &mut RocksDbStatus,
+        );
+        fn drop_relation_cf(self: &RocksDbBridge, id: u64, status: &mut RocksDbStatus);
+        fn relation_cf_ids(self: &RocksDbBridge) -> Vec<u64>;
+        fn set_relation_retention(self: &RocksDbBridge, id: u64, retention_micros: i64);
+        fn clear_relation_retention(self: &RocksDbBridge, id: u64);
+
+        type WriteBatchBridge;
+        fn put(
+            self: Pin<&mut WriteBatchBridge>,
+            key: &[u8],
+            val: &[u8],
+            status: &mut RocksDbStatus,
+        );
+        fn disable_wal(self: Pin<&mut WriteBatchBridge>, val: bool);
+        fn count(self: &WriteBatchBridge) -> usize;
+        fn data_size(self: &WriteBatchBridge) -> usize;
+        fn commit(self: Pin<&mut WriteBatchBridge>, status: &mut RocksDbStatus);
 
         type SstFileWriterBridge;
         fn put(
@@ -163,9 +425,21 @@ pub(crate) mod ffi {
             for_update: bool,
             status: &mut RocksDbStatus,
         ) -> UniquePtr<PinnableSlice>;
+        fn multi_get(
+            self: &TxBridge,
+            keys: &[u8],
+            key_offsets: &[usize],
+            for_update: bool,
+            with_values: bool,
+            vals: &mut Vec<u8>,
+            val_offsets: &mut Vec<usize>,
+            found: &mut Vec<bool>,
+            status: &mut RocksDbStatus,
+        );
         fn exists(self: &TxBridge, key: &[u8], for_update: bool, status: &mut RocksDbStatus);
         fn put(self: &TxBridge, key: &[u8], val: &[u8], status: &mut RocksDbStatus);
         fn del(self: &TxBridge, key: &[u8], status: &mut RocksDbStatus);
+        fn merge(self: &TxBridge, key: &[u8], operand: &[u8], status: &mut RocksDbStatus);
         fn commit(self: Pin<&mut TxBridge>, status: &mut RocksDbStatus);
         fn rollback(self: Pin<&mut TxBridge>, status: &mut RocksDbStatus);
         fn rollback_to_savepoint(self: Pin<&mut TxBridge>, status: &mut RocksDbStatus);
@@ -173,11 +447,19 @@ pub(crate) mod ffi {
         fn set_savepoint(self: Pin<&mut TxBridge>);
         fn iterator(self: &TxBridge) -> UniquePtr<IterBridge>;
 
+        type WalIterBridge;
+        fn next_batch(
+            self: Pin<&mut WalIterBridge>,
+            entries: &mut Vec<WalEntry>,
+            status: &mut RocksDbStatus,
+        ) -> bool;
+
         type IterBridge;
         fn start(self: Pin<&mut IterBridge>);
         fn reset(self: Pin<&mut IterBridge>);
         // fn get_r_opts(self: Pin<&mut IterBridge>) -> Pin<&mut ReadOptions>;
         fn clear_bounds(self: Pin<&mut IterBridge>);
+        fn use_cf_of(self: Pin<&mut IterBridge>, key: &[u8]);
         fn set_lower_bound(self: Pin<&mut IterBridge>, bound: &[u8]);
         fn set_upper_bound(self: Pin<&mut IterBridge>, bound: &[u8]);
         fn verify_checksums(self: Pin<&mut IterBridge>, val: bool);
@@ -198,6 +480,15 @@ pub(crate) mod ffi {
         fn status(self: &IterBridge, status: &mut RocksDbStatus);
         fn key(self: &IterBridge) -> &[u8];
         fn val(self: &IterBridge) -> &[u8];
+        fn next_batch(
+            self: Pin<&mut IterBridge>,
+            max_rows: usize,
+            max_bytes: usize,
+            end: &[u8],
+            buf: &mut Vec<u8>,
+            offsets: &mut Vec<usize>,
+            status: &mut RocksDbStatus,
+        ) -> usize;
     }
 }
 
@@ -243,7 +534,27 @@ impl Diagnostic for ffi::RocksDbStatus {
         }
     }
     fn help<'a>(&'a self) -> Option<Box<dyn Display + 'a>> {
-        Some(Box::new("This error is usually outside Cozo's control"))
+        if self.is_retryable() {
+            Some(Box::new(
+                "The transaction contended with a concurrent one and can be retried",
+            ))
+        } else {
+            Some(Box::new("This error is usually outside Cozo's control"))
+        }
+    }
+}
+
+impl ffi::RangeStats {
+    /// Estimated number of keys in the range: the memtable entries, plus the SST bytes
+    /// divided by the average size of an entry in the SST files of the column family.
+    pub fn estimated_keys(&self) -> u64 {
+        let sst_keys = self.cf_num_keys.saturating_sub(self.cf_memtable_entries);
+        let file_keys = if sst_keys == 0 || self.cf_live_bytes == 0 {
+            0
+        } else {
+            (self.file_bytes as f64 * sst_keys as f64 / self.cf_live_bytes as f64) as u64
+        };
+        self.memtable_count + file_keys
     }
 }
 
@@ -260,4 +571,28 @@ impl ffi::RocksDbStatus {
     pub fn is_ok_or_not_found(&self) -> bool {
         self.is_ok() || self.is_not_found()
     }
+    /// Whether the transaction conflicted with a concurrent one, in which case it can be retried.
+    /// Optimistic transactions report conflicts this way when committing.
+    #[inline(always)]
+    pub fn is_conflict(&self) -> bool {
+        (self.code == ffi::StatusCode::kBusy || self.code == ffi::StatusCode::kTryAgain)
+            && !self.is_deadlock()
+    }
+    /// Whether a pessimistic transaction gave up waiting for a lock held by another one.
+    /// The transaction can be retried.
+    #[inline(always)]
+    pub fn is_lock_timeout(&self) -> bool {
+        self.code == ffi::StatusCode::kTimedOut && self.subcode == ffi::StatusSubCode::kLockTimeout
+    }
+    /// Whether a pessimistic transaction was chosen to fail to break a deadlock.
+    /// The transaction can be retried.
+    #[inline(always)]
+    pub fn is_deadlock(&self) -> bool {
+        self.code == ffi::StatusCode::kBusy && self.subcode == ffi::StatusSubCode::kDeadlock
+    }
+    /// Whether running the transaction again may succeed.
+    #[inline(always)]
+    pub fn is_retryable(&self) -> bool {
+        self.is_conflict() || self.is_lock_timeout() || self.is_deadlock()
+    }
 }
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022, The Cozo Project Authors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+use cxx::*;
+
+use crate::bridge::ffi::*;
+use crate::bridge::iter::IterBuilder;
+use crate::bridge::tx::{packed_multi_get, MultiGetResults, PinSlice};
+
+/// A consistent read-only view of the database, backed by a RocksDB snapshot
+/// instead of a transaction.
+pub struct DbSnapshot {
+    pub(crate) inner: UniquePtr<SnapshotBridge>,
+}
+
+impl DbSnapshot {
+    #[inline]
+    pub fn get(&self, key: &[u8]) -> Result<Option<PinSlice>, RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        let ret = self.inner.get(key, &mut status);
+        match status.code {
+            StatusCode::kOk => Ok(Some(PinSlice { inner: ret })),
+            StatusCode::kNotFound => Ok(None),
+            _ => Err(status),
+        }
+    }
+    /// Get multiple keys with a single batched lookup.
+    pub fn multi_get<K: AsRef<[u8]>>(
+        &self,
+        keys: &[K],
+    ) -> Result<Vec<Option<Vec<u8>>>, RocksDbStatus> {
+        Ok(self.packed_multi_get(keys, true)?.values())
+    }
+    /// Check whether multiple keys exist with a single batched lookup, without copying values.
+    pub fn multi_exists<K: AsRef<[u8]>>(&self, keys: &[K]) -> Result<Vec<bool>, RocksDbStatus> {
+        Ok(self.packed_multi_get(keys, false)?.found())
+    }
+    fn packed_multi_get<K: AsRef<[u8]>>(
+        &self,
+        keys: &[K],
+        with_values: bool,
+    ) -> Result<MultiGetResults, RocksDbStatus> {
+        packed_multi_get(
+            keys,
+            |packed_keys, key_offsets, vals, val_offsets, found, status| {
+                self.inner.multi_get(
+                    packed_keys,
+                    key_offsets,
+                    with_values,
+                    vals,
+                    val_offsets,
+                    found,
+                    status,
+                )
+            },
+        )
+    }
+    #[inline]
+    pub fn exists(&self, key: &[u8]) -> Result<bool, RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.exists(key, &mut status);
+        match status.code {
+            StatusCode::kOk => Ok(true),
+            StatusCode::kNotFound => Ok(false),
+            _ => Err(status),
+        }
+    }
+    #[inline]
+    pub fn iterator(&self) -> IterBuilder {
+        IterBuilder {
+            inner: self.inner.iterator(),
+        }
+        .auto_prefix_mode(true)
+    }
+}
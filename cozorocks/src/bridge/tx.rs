@@ -42,6 +42,68 @@ impl Debug for PinSlice {
     }
 }
 
+/// Results of a bridge-level multi-get: which keys were found, and unless only their existence
+/// was asked for, the values found packed back-to-back with the end offset of each key's value.
+pub(crate) struct MultiGetResults {
+    found: Vec<bool>,
+    vals: Vec<u8>,
+    val_offsets: Vec<usize>,
+}
+
+impl MultiGetResults {
+    pub(crate) fn found(self) -> Vec<bool> {
+        self.found
+    }
+    pub(crate) fn values(self) -> Vec<Option<Vec<u8>>> {
+        let mut start = 0;
+        self.found
+            .into_iter()
+            .zip(self.val_offsets)
+            .map(|(is_found, end)| {
+                let ret = if is_found {
+                    Some(self.vals[start..end].to_vec())
+                } else {
+                    None
+                };
+                start = end;
+                ret
+            })
+            .collect()
+    }
+}
+
+/// Packs `keys` for a bridge-level multi-get performed by `f`.
+pub(crate) fn packed_multi_get<K: AsRef<[u8]>>(
+    keys: &[K],
+    f: impl FnOnce(&[u8], &[usize], &mut Vec<u8>, &mut Vec<usize>, &mut Vec<bool>, &mut RocksDbStatus),
+) -> Result<MultiGetResults, RocksDbStatus> {
+    let mut packed_keys = Vec::with_capacity(keys.iter().map(|k| k.as_ref().len()).sum());
+    let mut key_offsets = Vec::with_capacity(keys.len());
+    for key in keys {
+        packed_keys.extend_from_slice(key.as_ref());
+        key_offsets.push(packed_keys.len());
+    }
+    let mut ret = MultiGetResults {
+        found: vec![],
+        vals: vec![],
+        val_offsets: vec![],
+    };
+    let mut status = RocksDbStatus::default();
+    f(
+        &packed_keys,
+        &key_offsets,
+        &mut ret.vals,
+        &mut ret.val_offsets,
+        &mut ret.found,
+        &mut status,
+    );
+    if status.is_ok() {
+        Ok(ret)
+    } else {
+        Err(status)
+    }
+}
+
 impl TxBuilder {
     #[inline]
     pub fn start(mut self) -> Tx {
@@ -107,6 +169,18 @@ impl Tx {
             Err(status)
         }
     }
+    /// Write a merge operand for the key, to be combined with its value by the function
+    /// given to [crate::set_merge_fn] when the key is read or compacted.
+    #[inline]
+    pub fn merge(&self, key: &[u8], operand: &[u8]) -> Result<(), RocksDbStatus> {
+        let mut status = RocksDbStatus::default();
+        self.inner.merge(key, operand, &mut status);
+        if status.is_ok() {
+            Ok(())
+        } else {
+            Err(status)
+        }
+    }
     #[inline]
     pub fn del(&self, key: &[u8]) -> Result<(), RocksDbStatus> {
         let mut status = RocksDbStatus::default();
@@ -127,6 +201,44 @@ impl Tx {
             _ => Err(status),
         }
     }
+    /// Get multiple keys with a single batched lookup.
+    pub fn multi_get<K: AsRef<[u8]>>(
+        &self,
+        keys: &[K],
+        for_update: bool,
+    ) -> Result<Vec<Option<Vec<u8>>>, RocksDbStatus> {
+        Ok(self.packed_multi_get(keys, for_update, true)?.values())
+    }
+    /// Check whether multiple keys exist with a single batched lookup, without copying values.
+    pub fn multi_exists<K: AsRef<[u8]>>(
+        &self,
+        keys: &[K],
+        for_update: bool,
+    ) -> Result<Vec<bool>, RocksDbStatus> {
+        Ok(self.packed_multi_get(keys, for_update, false)?.found())
+    }
+    fn packed_multi_get<K: AsRef<[u8]>>(
+        &self,
+        keys: &[K],
+        for_update: bool,
+        with_values: bool,
+    ) -> Result<MultiGetResults, RocksDbStatus> {
+        packed_multi_get(
+            keys,
+            |packed_keys, key_offsets, vals, val_offsets, found, status| {
+                self.inner.multi_get(
+                    packed_keys,
+                    key_offsets,
+                    for_update,
+                    with_values,
+                    vals,
+                    val_offsets,
+                    found,
+                    status,
+                )
+            },
+        )
+    }
     #[inline]
     pub fn exists(&self, key: &[u8], for_update: bool) -> Result<bool, RocksDbStatus> {
         let mut status = RocksDbStatus::default();
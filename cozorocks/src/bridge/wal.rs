@@ -0,0 +1,39 @@
+/*
+ * Copyright 2022, The Cozo Project Authors.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+use cxx::*;
+
+use crate::bridge::ffi::*;
+
+pub const WAL_OP_PUT: u8 = 0;
+pub const WAL_OP_DELETE: u8 = 1;
+pub const WAL_OP_MERGE: u8 = 2;
+/// The key and value of the entry are the start and end of the deleted range
+pub const WAL_OP_DELETE_RANGE: u8 = 3;
+
+/// Reads the write batches in the write-ahead log, as of when it was created.
+pub struct WalIter {
+    pub(crate) inner: UniquePtr<WalIterBridge>,
+}
+
+impl WalIter {
+    /// The entries of the next write batch, or `None` when there are no more. Each entry has
+    /// the sequence number of the batch plus its position in the batch.
+    pub fn next_batch(&mut self) -> Result<Option<Vec<WalEntry>>, RocksDbStatus> {
+        let mut entries = vec![];
+        let mut status = RocksDbStatus::default();
+        let found = self.inner.pin_mut().next_batch(&mut entries, &mut status);
+        if !status.is_ok() {
+            Err(status)
+        } else if found {
+            Ok(Some(entries))
+        } else {
+            Ok(None)
+        }
+    }
+}
@@ -9,17 +9,38 @@
 #![warn(rust_2018_idioms, future_incompatible)]
 #![allow(clippy::type_complexity)]
 
+pub use bridge::backup::list_backups;
+pub use bridge::backup::restore_backup;
+pub use bridge::backup::verify_backup;
+pub use bridge::db::perf_start;
+pub use bridge::db::perf_stop;
 pub use bridge::db::DbBuilder;
 pub use bridge::db::RocksDb;
+pub use bridge::db::WriteBatch;
+pub use bridge::ffi::BackupEntry;
+pub use bridge::ffi::BackupOpts;
+pub use bridge::ffi::CacheStats;
+pub use bridge::ffi::CfOpts;
+pub use bridge::ffi::OpenTimings;
+pub use bridge::ffi::PerfStats;
+pub use bridge::ffi::RangeStats;
+pub use bridge::ffi::RelationTableStats;
 pub use bridge::ffi::RocksDbStatus;
 pub use bridge::ffi::SnapshotBridge;
 pub use bridge::ffi::StatusCode;
 pub use bridge::ffi::StatusSeverity;
 pub use bridge::ffi::StatusSubCode;
+pub use bridge::ffi::WalEntry;
 pub use bridge::iter::DbIter;
 pub use bridge::iter::IterBuilder;
+pub use bridge::iter::RowBatch;
+pub use bridge::merge::set_merge_fn;
+pub use bridge::merge::MergeFn;
+pub use bridge::snapshot::DbSnapshot;
 pub use bridge::tx::PinSlice;
 pub use bridge::tx::Tx;
 pub use bridge::tx::TxBuilder;
+pub use bridge::wal::WalIter;
+pub use bridge::wal::{WAL_OP_DELETE, WAL_OP_DELETE_RANGE, WAL_OP_MERGE, WAL_OP_PUT};
 
 pub(crate) mod bridge;